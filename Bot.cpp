@@ -0,0 +1,66 @@
+#include "Bot.hpp"
+#include "PlayerBatch.hpp"
+
+// steps without moving before the bot tries to jump over the obstacle
+static constexpr uint STUCK_JUMP    = 8;
+// steps without moving before the bot turns around
+static constexpr uint STUCK_TURN    = 120;
+// 1 in JUMP_CHANCE steps the bot jumps for no reason
+static constexpr uint JUMP_CHANCE   = 240;
+
+uint Bot::_next_random() {
+    // xorshift32, seed must not be 0
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+Input Bot::drive(const Player &player, const Map &map, const FlowField &flow) {
+    if (seed == 0) seed = 1;
+    const auto [x, y] = player.pos;
+
+    if (player.pos.x == _last_x) {
+        ++_stuck_steps;
+    } else {
+        _stuck_steps = 0;
+    }
+    _last_x = player.pos.x;
+
+    // O(1) a step however many bots there are
+    if (flow.distance(x, y) != FlowField::UNREACHABLE) {
+        const auto move = flow.move(x, y);
+        // straight up or down it brakes, the momentum would carry it under ledges
+        Direction direction = player.vel.x > 0 ? Left : player.vel.x < 0 ? Right : None;
+        if (move == FlowField::Move::Left)  direction = Left;
+        if (move == FlowField::Move::Right) direction = Right;
+        // and already where braking would still carry it, if the way turns there
+        const Real v = player.vel.x;
+        const int stop = (v * v / (PlayerBatch::ACCEL * 2)).round();
+        const int ahead = v > 0 ? x + stop : x - stop;
+        if (((direction == Right && v > 0) || (direction == Left && v < 0))
+            && flow.move(ahead, y) != move) {
+            direction = v > 0 ? Left : Right;
+        }
+        return {
+            .direction  = direction,
+            .jump       = move == FlowField::Move::Up || _stuck_steps >= STUCK_JUMP,
+        };
+    }
+
+    // head to the finish once it's known, but wander off when stuck there
+    if (map.finish_initialised && _stuck_steps == 0) {
+        const int target_x = std::get<0>(map.finish_point);
+        if      (target_x < player.pos.x - 2) heading = Left;
+        else if (target_x > player.pos.x + 2) heading = Right;
+    }
+
+    if (_stuck_steps >= STUCK_TURN) {
+        heading = heading == Left ? Right : Left;
+        _stuck_steps = 0;
+    }
+    return {
+        .direction  = heading,
+        .jump       = _stuck_steps >= STUCK_JUMP || _next_random() % JUMP_CHANCE == 0,
+    };
+}
@@ -0,0 +1,24 @@
+#ifndef ADHTP_BOT_HDR
+#define ADHTP_BOT_HDR
+
+#include "types.hpp"
+#include "Map.hpp"
+#include "Player.hpp"
+#include "FlowField.hpp"
+
+// scripted input for a player, used by the headless mode
+struct Bot {
+    uint        seed        = 1;
+    Direction   heading     = Right;
+
+    // picks the player's input for the next simulation step, the way
+    // the flow field shows once it's ready, wandering about until then
+    Input drive(const Player &player, const Map &map, const FlowField &flow);
+
+private:
+    int         _last_x         = -1;
+    uint        _stuck_steps    = 0;
+    uint        _next_random();
+};
+
+#endif // ADHTP_BOT_HDR
@@ -0,0 +1,198 @@
+#include "FlowField.hpp"
+#include "PlayerBatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+
+// the ground at most this far below lets the player go up
+static constexpr int JUMP = PlayerBatch::JUMP_HEIGHT;
+static_assert(JUMP < 255, "heights above the ground are kept in a byte");
+// more rarely pays off, the strips trade their borders until nothing changes
+static constexpr uint MAX_THREADS = 4;
+
+static int cell_of(int x, int y) { return x + y * Map::WIDTH; }
+
+uint FlowField::distance(int x, int y) const {
+    if (!_ready || uint(x) >= uint(Map::WIDTH) || uint(y) >= uint(Map::HEIGHT)) {
+        return UNREACHABLE;
+    }
+    return _field.distance[cell_of(x, y)];
+}
+
+FlowField::Move FlowField::move(int x, int y) const {
+    if (!_ready || uint(x) >= uint(Map::WIDTH) || uint(y) >= uint(Map::HEIGHT)) {
+        return Move::None;
+    }
+    return _field.moves[cell_of(x, y)];
+}
+
+void FlowField::update(const Map &map) {
+    // started by the first update, a game without bots never pays for it
+    if (!_worker.joinable()) {
+        _worker = std::jthread([this](std::stop_token stop) { _run(stop); });
+    }
+    std::lock_guard lock(_mutex);
+    if (_built_new) {
+        std::swap(_field, _built);
+        _ready      = _field.ready;
+        _built_new  = false;
+    }
+    if (_requested && _revision == map.revision) return;
+    // a copy, the map keeps changing while the worker reads it
+    _cells.assign(map.data.begin(), map.data.end());
+    _cells_new  = true;
+    _requested  = true;
+    _revision   = map.revision;
+    _wake.notify_one();
+}
+
+void FlowField::_run(std::stop_token stop) {
+    std::vector<byte> cells;
+    Field field;
+    while (true) {
+        {
+            std::unique_lock lock(_mutex);
+            if (!_wake.wait(lock, stop, [this] { return _cells_new; })) return;
+            std::swap(cells, _cells);
+            _cells_new = false;
+        }
+        _build(cells, field);
+
+        // only the newest build is kept, update swaps it in
+        std::lock_guard lock(_mutex);
+        std::swap(_built, field);
+        _built_new = true;
+    }
+}
+
+void FlowField::_build(std::span<const byte> cells, Field &field) {
+    auto &dist = field.distance;
+    dist.assign(Map::SIZE, UNREACHABLE);
+    field.moves.assign(Map::SIZE, Move::None);
+    field.ready = std::find(cells.begin(), cells.end(), CellType::FINISH) != cells.end();
+    if (!field.ready) return;
+
+    // like Map::is_wall, the border is a wall whatever is drawn over it
+    auto is_wall = [cells](int x, int y) {
+        return x <= 0 || y <= 0 || x >= Map::WIDTH - 1 || y >= Map::HEIGHT - 1
+            || is_solid(cells[cell_of(x, y)]);
+    };
+    auto at = [&dist](int x, int y) {
+        if (uint(x) >= uint(Map::WIDTH) || uint(y) >= uint(Map::HEIGHT)) return UNREACHABLE;
+        return dist[cell_of(x, y)];
+    };
+    // free cells between a cell and the ground, capped past a jump
+    std::vector<byte> above_ground(Map::SIZE);
+
+    /* every thread searches its strip of columns alone, from FINISH *
+     * and from the distances its neighbours reached at the border,  *
+     * rounds of it go on until no border distance gets shorter      */
+    const uint threads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_THREADS);
+    std::atomic<bool> changed = false;
+    bool again = true;
+    std::barrier relaxed(threads);
+    std::barrier traded(threads, [&]() noexcept { again = changed.exchange(false); });
+
+    auto work = [&](uint t) {
+        const int x0 = Map::WIDTH * t / threads;
+        const int x1 = Map::WIDTH * (t + 1) / threads;
+        for (int x = x0; x < x1; ++x) {
+            int above = 0;
+            for (int y = Map::HEIGHT - 1; y >= 0; --y) {
+                above = is_wall(x, y + 1) ? 0 : std::min(above + 1, JUMP + 1);
+                above_ground[cell_of(x, y)] = above;
+            }
+        }
+        // sideways only within a jump of the ground, higher up the player falls
+        auto can_steer = [&](int x, int y) {
+            return !is_wall(x, y) && above_ground[cell_of(x, y)] <= JUMP;
+        };
+
+        // distance and cell, applied and then searched from in order
+        std::vector<std::pair<uint, uint>> seeds;
+        std::vector<uint> queue;
+        for (int y = 0; y < Map::HEIGHT; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                if (cells[cell_of(x, y)] == CellType::FINISH && !is_wall(x, y)) {
+                    seeds.push_back({0, cell_of(x, y)});
+                }
+            }
+        }
+
+        // the cell (x, y) of the strip gets to one `d` away in a move
+        auto reach = [&](int x, int y, uint d) {
+            const int i = cell_of(x, y);
+            if (d + 1 >= dist[i]) return;
+            dist[i] = d + 1;
+            queue.push_back(i);
+        };
+        // backwards over the moves: sideways, falling from above and rising from below
+        auto relax = [&]() {
+            for (auto [d, i]: seeds) dist[i] = std::min(dist[i], d);
+            std::sort(seeds.begin(), seeds.end());
+            queue.clear();
+            size_t head = 0, next_seed = 0;
+            // the seeds merged into the queue, both come in distance order
+            while (head < queue.size() || next_seed < seeds.size()) {
+                int i;
+                if (next_seed < seeds.size()
+                    && (head == queue.size() || seeds[next_seed].first <= dist[queue[head]])) {
+                    const auto [d, seed] = seeds[next_seed++];
+                    // something shorter reached it since
+                    if (dist[seed] != d) continue;
+                    i = seed;
+                } else {
+                    i = queue[head++];
+                }
+                const uint d = dist[i];
+                const int x = i % Map::WIDTH;
+                const int y = i / Map::WIDTH;
+                if (x - 1 >= x0 && can_steer(x - 1, y)) reach(x - 1, y, d);
+                if (x + 1 < x1  && can_steer(x + 1, y)) reach(x + 1, y, d);
+                if (!is_wall(x, y - 1)) reach(x, y - 1, d);
+                if (!is_wall(x, y + 1) && above_ground[cell_of(x, y + 1)] < JUMP) {
+                    reach(x, y + 1, d);
+                }
+            }
+            seeds.clear();
+        };
+        // the border cell steps sideways into the neighbour's, only reads
+        auto trade = [&](int x, int next_x) {
+            for (int y = 0; y < Map::HEIGHT; ++y) {
+                const uint d = at(next_x, y);
+                if (d == UNREACHABLE || !can_steer(x, y) || d + 1 >= dist[cell_of(x, y)]) continue;
+                seeds.push_back({d + 1, cell_of(x, y)});
+            }
+        };
+
+        relax();
+        while (true) {
+            relaxed.arrive_and_wait();
+            if (x0 > 0)             trade(x0, x0 - 1);
+            if (x1 < Map::WIDTH)    trade(x1 - 1, x1);
+            if (!seeds.empty()) changed = true;
+            traded.arrive_and_wait();
+            if (!again) break;
+            relax();
+        }
+
+        // the move to a neighbour one step closer, sideways first
+        for (int y = 0; y < Map::HEIGHT; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                const uint d = dist[cell_of(x, y)];
+                if (d == 0 || d == UNREACHABLE) continue;
+                auto &move = field.moves[cell_of(x, y)];
+                const byte above = above_ground[cell_of(x, y)];
+                if      (above <= JUMP && at(x - 1, y) == d - 1) move = Move::Left;
+                else if (above <= JUMP && at(x + 1, y) == d - 1) move = Move::Right;
+                else if (at(x, y + 1) == d - 1) move = Move::Down;
+                else if (above < JUMP && at(x, y - 1) == d - 1) move = Move::Up;
+            }
+        }
+    };
+
+    std::vector<std::jthread> helpers;
+    for (uint t = 1; t < threads; ++t) helpers.emplace_back(work, t);
+    work(0);
+}
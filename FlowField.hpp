@@ -0,0 +1,72 @@
+#ifndef ADHTP_FLOW_FIELD_HDR
+#define ADHTP_FLOW_FIELD_HDR
+
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "types.hpp"
+#include "Map.hpp"
+
+/* steps to FINISH from every free cell, over the moves a player can   *
+ * make: down anywhere, sideways and up only while the ground is no    *
+ * further below than a jump rises, built by a breadth first search    *
+ * backwards from every FINISH cell, on a worker thread of its own     *
+ * with the map split into strips of columns, a thread each, which     *
+ * trade the distances at their borders until none of them changes    *
+ * any number of bots then read their next move off it in O(1)         */
+struct FlowField {
+    static constexpr uint UNREACHABLE = UINT32_MAX;
+
+    enum class Move: byte {
+        None,       // FINISH, unreachable or a wall
+        Left,
+        Right,
+        Up,
+        Down,
+    };
+
+    FlowField() = default;
+    FlowField(const FlowField &) = delete;
+    FlowField &operator=(const FlowField &) = delete;
+
+    // swaps in the field the worker finished, and hands it a copy of the
+    // map if it changed since the last one, never waits for a build
+    void update(const Map &map);
+    // false until a map with FINISH on it was built
+    bool ready() const { return _ready; }
+
+    uint distance(int x, int y) const;
+    // the first move of a shortest way to FINISH
+    Move move(int x, int y) const;
+
+private:
+    struct Field {
+        std::vector<uint>   distance;
+        std::vector<Move>   moves;
+        bool                ready = false;
+    };
+
+    // read by the bots, only swapped in update
+    Field               _field;
+    bool                _ready      = false;
+    bool                _requested  = false;
+    u64                 _revision   = 0;
+
+    // shared with the worker
+    std::mutex                  _mutex;
+    std::condition_variable_any _wake;
+    std::vector<byte>           _cells;             // the map to build next
+    bool                        _cells_new  = false;
+    Field                       _built;             // the last build, not swapped in yet
+    bool                        _built_new  = false;
+    // last, stopped and joined before the rest goes, started by update
+    std::jthread                _worker;
+
+    void _run(std::stop_token stop);
+    static void _build(std::span<const byte> cells, Field &field);
+};
+
+#endif // ADHTP_FLOW_FIELD_HDR
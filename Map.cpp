@@ -1,7 +1,14 @@
 #include "Map.hpp"
+#include "map_stream.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
 
 inline byte &at(Map &self, const int x, const int y) {
-    return self.data.at(x + y * self.WIDTH);
+    return self.data[x + y * self.WIDTH];
 }
 
 static constexpr int BRUSH_SIZE = 13;
@@ -16,34 +23,212 @@ SDL_Colour get_cell_colour(byte cell) {
             return {100,100,100,255};
         case CellType::EMPTY:
             return {0,0,0,255};
+        case CellType::UNKNOWN:
+            return {40,40,40,255};
         default:
             return {255,0,255,255};
     }
 }
 
-Map::Map() {
-    data.fill(0);
+// pixel layout of the map texture, SDL_PIXELFORMAT_RGBA8888
+static uint32_t rgba8888(SDL_Colour c) {
+    return uint32_t(c.r) << 24 | uint32_t(c.g) << 16 | uint32_t(c.b) << 8 | c.a;
+}
+
+struct Palette {
+    uint32_t empty, wall, start, finish, unknown, other;
+};
+
+static Palette make_palette() {
+    return {
+        .empty      = rgba8888(get_cell_colour(CellType::EMPTY)),
+        .wall       = rgba8888(get_cell_colour(CellType::WALL)),
+        .start      = rgba8888(get_cell_colour(CellType::START)),
+        .finish     = rgba8888(get_cell_colour(CellType::FINISH)),
+        .unknown    = rgba8888(get_cell_colour(CellType::UNKNOWN)),
+        .other      = rgba8888(get_cell_colour(0x01)),
+    };
+}
+
+using v16u8  = byte     __attribute__((vector_size(16)));
+using v16u32 = uint32_t __attribute__((vector_size(64)));
+static_assert(Map::WIDTH % sizeof(v16u8) == 0, "rows are converted 16 cells at a time");
+
+enum RowFlags: byte {
+    ROW_HAS_START   = 0x01,
+    ROW_HAS_FINISH  = 0x02,
+};
+
+// converts count cells of a row into texture pixels, 16 cells per iteration
+// returns RowFlags telling whether the row holds START / FINISH cells
+static byte convert_row(const byte *cells, uint32_t *pixels, const int count, const Palette &pal) {
+    v16u8 starts    = {};
+    v16u8 finishes  = {};
+    for (int x = 0; x < count; x += sizeof(v16u8)) {
+        v16u8 c;
+        memcpy(&c, cells + x, sizeof(c));
+        const v16u32 c32 = __builtin_convertvector(c, v16u32);
+
+        v16u32 px = v16u32{} + pal.other;
+        px = c32 == uint32_t(CellType::EMPTY)  ? pal.empty  : px;
+        px = c32 == uint32_t(CellType::WALL)   ? pal.wall   : px;
+        px = c32 == uint32_t(CellType::START)  ? pal.start  : px;
+        px = c32 == uint32_t(CellType::FINISH) ? pal.finish : px;
+        px = c32 == uint32_t(CellType::UNKNOWN)? pal.unknown: px;
+        memcpy(pixels + x, &px, sizeof(px));
+
+        starts   |= (v16u8)(c == byte(CellType::START));
+        finishes |= (v16u8)(c == byte(CellType::FINISH));
+    }
+    byte flags = 0;
+    for (uint i = 0; i < sizeof(v16u8); ++i) {
+        if (starts[i])   flags |= ROW_HAS_START;
+        if (finishes[i]) flags |= ROW_HAS_FINISH;
+    }
+    return flags;
+}
+
+inline bool is_border(const int x, const int y) {
+    return x <= 0 || x >= Map::WIDTH - 1 || y <= 0 || y >= Map::HEIGHT - 1;
+}
+
+// sets or clears the wall bits of [x0, x1] in row y, a word at a time
+void _set_wall_span(Map &self, const int y, const int x0, const int x1, const bool wall) {
+    u64 *row = self._walls.data() + y * Map::ROW_WORDS;
+    for (int w = x0 / 64; w <= x1 / 64; ++w) {
+        const int lo = std::max(x0, w * 64) - w * 64;
+        const int hi = std::min(x1, w * 64 + 63) - w * 64;
+        const u64 mask = (~u64(0) >> (63 - hi)) & (~u64(0) << lo);
+        if (wall) row[w] |= mask;
+        else      row[w] &= ~mask;
+    }
 }
 
-void _write_at(Map &self, const int x, const int y, byte value, const int size) {
-    for (int iy = y; iy < y + size; iy++) {
-        for (int ix = x; ix < x + size; ix++) {
-            if (ix >= self.WIDTH || ix < 0 || iy >= self.HEIGHT || iy < 0) continue;
-            at(self, ix, iy) = value;
+// recomputes the wall bits of [x0, x1] x [y0, y1] from the cells
+void _rebuild_walls(Map &self, const int x0, const int y0, const int x1, const int y1) {
+    for (int y = y0; y <= y1; ++y) {
+        const byte *cells = self.data.data() + y * Map::WIDTH;
+        u64 *row = self._walls.data() + y * Map::ROW_WORDS;
+        for (int w = x0 / 64; w <= x1 / 64; ++w) {
+            const int lo = std::max(x0, w * 64) - w * 64;
+            const int hi = std::min(x1, w * 64 + 63) - w * 64;
+            const u64 mask = (~u64(0) >> (63 - hi)) & (~u64(0) << lo);
+            u64 bits = 0;
+            for (int i = lo; i <= hi; ++i) {
+                bits |= u64(is_solid(cells[w * 64 + i])) << i;
+            }
+            row[w] = (row[w] & ~mask) | bits;
+        }
+        if (y == 0 || y == Map::HEIGHT - 1) {
+            _set_wall_span(self, y, x0, x1, true);
+        } else {
+            if (x0 == 0)                _set_wall_span(self, y, 0, 0, true);
+            if (x1 == Map::WIDTH - 1)   _set_wall_span(self, y, x1, x1, true);
         }
     }
 }
-void _draw_at(Map &self, const int x, const int y, const CellType value, const int size) {
+
+// two pass chamfer distance with unit weights for all 8 neighbours
+// dist has to hold 0 at the seeds and SDF_MAX + 1 everywhere else
+static void chamfer(std::vector<byte> &dist, const int w, const int h) {
+    auto at = [&](int x, int y) -> byte& { return dist[x + y * w]; };
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int d = at(x, y);
+            if (x > 0)                  d = std::min(d, at(x - 1, y) + 1);
+            if (y > 0) {
+                d = std::min(d, at(x, y - 1) + 1);
+                if (x > 0)              d = std::min(d, at(x - 1, y - 1) + 1);
+                if (x < w - 1)          d = std::min(d, at(x + 1, y - 1) + 1);
+            }
+            at(x, y) = std::min(d, Map::SDF_MAX);
+        }
+    }
+    for (int y = h - 1; y >= 0; --y) {
+        for (int x = w - 1; x >= 0; --x) {
+            int d = at(x, y);
+            if (x < w - 1)              d = std::min(d, at(x + 1, y) + 1);
+            if (y < h - 1) {
+                d = std::min(d, at(x, y + 1) + 1);
+                if (x < w - 1)          d = std::min(d, at(x + 1, y + 1) + 1);
+                if (x > 0)              d = std::min(d, at(x - 1, y + 1) + 1);
+            }
+            at(x, y) = d;
+        }
+    }
+}
+
+// recomputes the distance field within [x0, x1] x [y0, y1], the distance
+// is capped so only cells SDF_MAX away matter
+void _update_fields(Map &self, int x0, int y0, int x1, int y1) {
+    constexpr int R = Map::SDF_MAX;
+    x0 = std::max(x0, 0);               y0 = std::max(y0, 0);
+    x1 = std::min(x1, Map::WIDTH - 1);  y1 = std::min(y1, Map::HEIGHT - 1);
+    if (x0 > x1 || y0 > y1) return;
+
+    const int wx0 = std::max(x0 - R, 0), wx1 = std::min(x1 + R, Map::WIDTH - 1);
+    const int wy0 = std::max(y0 - R, 0), wy1 = std::min(y1 + R, Map::HEIGHT - 1);
+    const int w = wx1 - wx0 + 1;
+    const int h = wy1 - wy0 + 1;
+
+    // distance to walls for free cells, distance to free cells for walls
+    std::vector<byte> to_wall(w * h), to_free(w * h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const bool wall = self.is_wall(wx0 + x, wy0 + y);
+            to_wall[x + y * w] = wall ? 0 : R + 1;
+            to_free[x + y * w] = wall ? R + 1 : 0;
+        }
+    }
+    chamfer(to_wall, w, h);
+    chamfer(to_free, w, h);
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const int i = (x - wx0) + (y - wy0) * w;
+            self._sdf[x + y * Map::WIDTH] = to_wall[i] ? to_wall[i] : -to_free[i];
+        }
+    }
+}
+
+Map::Map() : data(_storage.data(), SIZE) {
+    _storage.fill(0);
+    _rebuild_walls(*this, 0, 0, WIDTH - 1, HEIGHT - 1);
+    _update_fields(*this, 0, 0, WIDTH - 1, HEIGHT - 1);
+}
+
+// fills the w x h rectangle at x, y
+void _write_at(Map &self, const int x, const int y, byte value, const int w, const int h) {
+    const int x0 = std::max(x, 0);
+    const int x1 = std::min(x + w, Map::WIDTH) - 1;
+    if (x0 > x1) return;
+    ++self.revision;
+    for (int iy = std::max(y, 0); iy < std::min(y + h, Map::HEIGHT); iy++) {
+        memset(&at(self, x0, iy), value, x1 - x0 + 1);
+        _set_wall_span(self, iy, x0, x1, is_solid(value));
+        // the border stays a wall no matter what is drawn over it
+        if (iy == 0 || iy == Map::HEIGHT - 1) {
+            _set_wall_span(self, iy, x0, x1, true);
+        }
+        if (x0 == 0)                _set_wall_span(self, iy, 0, 0, true);
+        if (x1 == Map::WIDTH - 1)   _set_wall_span(self, iy, x1, x1, true);
+    }
+    // everything up to SDF_MAX away from the stroke might have a new distance
+    _update_fields(self, x0 - Map::SDF_MAX, y - Map::SDF_MAX,
+                   x1 + Map::SDF_MAX, y + h - 1 + Map::SDF_MAX);
+}
+void _draw_at(Map &self, const int x, const int y, const CellType value, const int w, const int h) {
+    if (!self._renderer) return;
     // Set the target texture
     SDL_SetRenderTarget(SDL_GetRenderer(SDL_GetWindowFromID(0)), self._texture);
 	auto &renderer = self._renderer;
 	SDL_SetRenderTarget(renderer, self._texture);
 
     // Draw
-    SDL_Rect rect = {x, y, size, size};
+    SDL_Rect rect = {x, y, w, h};
     SDL_Color col = get_cell_colour(value);
     SDL_SetRenderDrawColor(
-        renderer, col.r, col.g, col.g, col.a);
+        renderer, col.r, col.g, col.b, col.a);
     SDL_RenderFillRect(
         renderer, &rect);
 
@@ -51,54 +236,167 @@ void _draw_at(Map &self, const int x, const int y, const CellType value, const i
     SDL_SetRenderTarget(renderer, NULL);
 }
 
-// calculates a reflection based on surface's gradient at point mx, my
-Vector2D Map::refl_vector(Vector2D const &vect, const float mx, const float my) const {
-    const int x = mx + 0.5f;
-    const int y = my + 0.5f;
-    float x0 = this->at_bnd(x-1, y-1) / 3.f
-             + this->at_bnd(x-1, y  ) / 3.f
-             + this->at_bnd(x-1, y+1) / 3.f;
-
-    float x1 = this->at_bnd(x+1, y-1) / 3.f
-             + this->at_bnd(x+1, y  ) / 3.f
-             + this->at_bnd(x+1, y+1) / 3.f;
+Map::Hit Map::sweep(const int x, const int y, const Real dx, const Real dy) const {
+    constexpr Real HALF = Real(0.5);
+    // cell n spans [n - 0.5, n + 0.5), shift so that it spans [n, n + 1)
+    const Real ux = Real(x) + HALF;
+    const Real uy = Real(y) + HALF;
+    const int end_x = (ux + dx).floor();
+    const int end_y = (uy + dy).floor();
 
-    float y0 = this->at_bnd(x-1, y+1) / 3.f
-             + this->at_bnd(x  , y+1) / 3.f
-             + this->at_bnd(x+1, y+1) / 3.f;
+    const int step_x = dx > 0 ? 1 : -1;
+    const int step_y = dy > 0 ? 1 : -1;
+    const Real INF = Real::max();
+    // parameter t along the segment at which the next cell border is crossed
+    const Real delta_x = dx != 0 ? abs(Real(1) / dx) : INF;
+    const Real delta_y = dy != 0 ? abs(Real(1) / dy) : INF;
+    const Real max_d   = std::max(abs(dx), abs(dy));
 
-    float y1 = this->at_bnd(x-1, y-1) / 3.f
-             + this->at_bnd(x  , y-1) / 3.f
-             + this->at_bnd(x+1, y-1) / 3.f;
+    int cx, cy, remain_x, remain_y;
+    Real next_x, next_y;
+    // (re)starts the traversal from the point at parameter t
+    auto start_at = [&](const Real t) {
+        const Real px = ux + dx * t;
+        const Real py = uy + dy * t;
+        cx = px.floor();
+        cy = py.floor();
+        next_x = dx > 0 ? t + (Real(cx + 1) - px) * delta_x
+               : dx < 0 ? t + (px - Real(cx)) * delta_x : INF;
+        next_y = dy > 0 ? t + (Real(cy + 1) - py) * delta_y
+               : dy < 0 ? t + (py - Real(cy)) * delta_y : INF;
+        // the cell count decides when to stop, so rounding in t can't skip the end cell
+        remain_x = std::abs(end_x - cx);
+        remain_y = std::abs(end_y - cy);
+    };
+    start_at(0);
+    Real t_cell = 0; // t at which the current cell was entered
 
-    // gradient
-    Vector2D surf_grad = {x1 - x0, y1 - y0};
-    surf_grad.normalize();
-    Vector2D norm_vect = vect;
-    norm_vect.normalize();
-    
-    return reflect(norm_vect, surf_grad);
+    Hit hit = {.hit = false, .x = cx, .y = cy};
+    while (remain_x + remain_y > 0) {
+        // every cell closer than the closest wall is free, jump over them at once
+        if (const int dist = distance(cx, cy); dist > 2) {
+            const Real t_skip = t_cell + (Real(dist) - Real(1.5)) / max_d;
+            if (t_skip >= 1) {
+                start_at(1);
+                hit.x = end_x;
+                hit.y = end_y;
+                return hit;
+            }
+            if (t_skip > next_x || t_skip > next_y) {
+                start_at(t_skip);
+                t_cell = t_skip;
+                hit.x = cx;
+                hit.y = cy;
+                if (remain_x + remain_y == 0) break;
+            }
+        }
+        if (remain_x > 0 && remain_y > 0 && next_x == next_y) {
+            // passing exactly through a corner, don't slip between two diagonal walls
+            if (is_wall(cx + step_x, cy)) {
+                hit = {true, cx, cy, cx + step_x, cy, -step_x, 0};
+                return hit;
+            }
+            if (is_wall(cx, cy + step_y)) {
+                hit = {true, cx, cy, cx, cy + step_y, 0, -step_y};
+                return hit;
+            }
+        }
+        int normal_x = 0, normal_y = 0;
+        if (remain_y == 0 || (remain_x > 0 && next_x <= next_y)) {
+            cx += step_x;
+            t_cell = next_x;
+            next_x += delta_x;
+            normal_x = -step_x;
+            --remain_x;
+        } else {
+            cy += step_y;
+            t_cell = next_y;
+            next_y += delta_y;
+            normal_y = -step_y;
+            --remain_y;
+        }
+        if (is_wall(cx, cy)) {
+            hit.hit         = true;
+            hit.cell_x      = cx;
+            hit.cell_y      = cy;
+            hit.normal_x    = normal_x;
+            hit.normal_y    = normal_y;
+            return hit;
+        }
+        hit.x = cx;
+        hit.y = cy;
+    }
+    return hit;
 }
 
-void Map::update(std::vector<byte> buff) {
-    memcpy(&this->data, buff.data(), buff.size());
+void Map::update() {
+    ++revision;
+    _rebuild_walls(*this, 0, 0, WIDTH - 1, HEIGHT - 1);
+    _update_fields(*this, 0, 0, WIDTH - 1, HEIGHT - 1);
+
+    const Palette pal = make_palette();
+    std::vector<uint32_t> pixels(SIZE);
+    // points already set came from the strokes or a header, every peer has those
+    const bool had_start    = start_initialised;
+    const bool had_finish   = finish_initialised;
+
     for (int y = 0; y < HEIGHT; ++y) {
-    for (int x = 0; x < WIDTH; ++x) {
-        auto value = this->at_bnd(x, y);
-        _draw_at(*this, x, y, (CellType)value, 1);
-        if ((CellType)value == START) {
-            this->start_point = std::tuple(x, y);
+        const byte *row = data.data() + y * WIDTH;
+        const byte flags = convert_row(row, pixels.data() + y * WIDTH, WIDTH, pal);
+        if (flags == 0) continue;
+
+        // rare, only a few rows hold these, keep the last cell like before
+        if (flags & ROW_HAS_START && !had_start) {
+            auto last = (const byte*)memrchr(row, CellType::START, WIDTH);
+            this->start_point = std::tuple(int(last - row), y);
             this->start_initialised = true;
         }
-        if ((CellType)value == FINISH) {
-            this->finish_point = std::tuple(x, y);
+        if (flags & ROW_HAS_FINISH && !had_finish) {
+            auto last = (const byte*)memrchr(row, CellType::FINISH, WIDTH);
+            this->finish_point = std::tuple(int(last - row), y);
             this->finish_initialised = true;
         }
     }
+    // a single upload instead of a draw call per cell
+    if (_texture && SDL_UpdateTexture(_texture, NULL, pixels.data(), WIDTH * sizeof(uint32_t))) {
+        LOG_ERR("Failed to upload the map texture: {}", SDL_GetError());
     }
     LOG_DBG("Refreshed the MAP STATE!");
 }
-void Map::handle_event(SDL_Event &event) {
+
+void Map::update(int x0, int y0, int x1, int y1) {
+    ++revision;
+    x0 = std::max(x0, 0);           y0 = std::max(y0, 0);
+    x1 = std::min(x1, WIDTH - 1);   y1 = std::min(y1, HEIGHT - 1);
+    if (x0 > x1 || y0 > y1) return;
+    _rebuild_walls(*this, x0, y0, x1, y1);
+    // the distances SDF_MAX around the rectangle might change as well
+    _update_fields(*this, x0 - SDF_MAX, y0 - SDF_MAX, x1 + SDF_MAX, y1 + SDF_MAX);
+    if (!_texture) return;
+
+    // whole vectors of cells, WIDTH is a multiple of them
+    constexpr int VEC = sizeof(v16u8);
+    x0 = x0 / VEC * VEC;
+    x1 = (x1 / VEC + 1) * VEC - 1;
+    const int w = x1 - x0 + 1;
+    const Palette pal = make_palette();
+    std::vector<uint32_t> pixels(w * (y1 - y0 + 1));
+    for (int y = y0; y <= y1; ++y) {
+        convert_row(data.data() + y * WIDTH + x0, pixels.data() + (y - y0) * w, w, pal);
+    }
+    const SDL_Rect rect = {x0, y0, w, y1 - y0 + 1};
+    if (SDL_UpdateTexture(_texture, &rect, pixels.data(), w * sizeof(uint32_t))) {
+        LOG_ERR("Failed to upload the map texture: {}", SDL_GetError());
+    }
+}
+
+void Map::fill(CellType cell) {
+    std::fill(data.begin(), data.end(), byte(cell));
+    start_initialised  = false;
+    finish_initialised = false;
+    update();
+}
+void Map::handle_event(SDL_Event &event, std::vector<Stroke> &strokes) {
     int x, y;
 
     const auto& ksymbl  = event.key.keysym.sym;
@@ -119,13 +417,13 @@ void Map::handle_event(SDL_Event &event) {
             break;
 
         case SDL_MOUSEBUTTONDOWN:
-            if (embttn.button != SDL_BUTTON_LEFT) break;
+            if (embttn.button != SDL_BUTTON_LEFT) return;
             _is_drawing = true;
             x = embttn.x;
             y = embttn.y;
             break;
         case SDL_MOUSEBUTTONUP:
-            if (embttn.button != SDL_BUTTON_LEFT) break;
+            if (embttn.button != SDL_BUTTON_LEFT) return;
             _is_drawing = false;
             return;
             break;
@@ -133,32 +431,98 @@ void Map::handle_event(SDL_Event &event) {
             x = event.motion.x;
             y = event.motion.y;
             break;
+        default:
+            return;
     } 
     if (_is_drawing && _brush_type != EMPTY) {
-        if (_brush_type == FINISH) {
-            if (!finish_initialised) {
-                finish_initialised = true;
-                finish_point = {x, y};
-            } else return;
-        }
+        // one of each, applying the stroke sets the point
+        if (_brush_type == FINISH && finish_initialised) return;
+        if (_brush_type == START  && start_initialised)  return;
 
-        if (_brush_type == START) {
-            if (!start_initialised) {
-                start_initialised = true;
-                start_point = {x, y};
-            } else return;
-        }
-
-        _draw_at(*this, x, y, _brush_type, BRUSH_SIZE);
-        _write_at(*this, x, y, _brush_type, BRUSH_SIZE);
+        // dragged out of the window the mouse goes past the map, and the
+        // wire format only fits coordinates within it
+        strokes.push_back(Stroke {
+            .x      = std::clamp(x, 0, WIDTH - 1),
+            .y      = std::clamp(y, 0, HEIGHT - 1),
+            .cell   = _brush_type,
+            .size   = BRUSH_SIZE,
+        });
     }
 }
 
+void Map::apply(const Stroke &stroke) {
+    _draw_at(*this, stroke.x, stroke.y, stroke.cell, stroke.size, stroke.size);
+    _write_at(*this, stroke.x, stroke.y, stroke.cell, stroke.size, stroke.size);
+}
+
+void Map::apply(const Stroke &stroke, int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, stroke.x);
+    y0 = std::max(y0, stroke.y);
+    x1 = std::min(x1, stroke.x + stroke.size - 1);
+    y1 = std::min(y1, stroke.y + stroke.size - 1);
+    if (x0 > x1 || y0 > y1) return;
+    _draw_at(*this, x0, y0, stroke.cell, x1 - x0 + 1, y1 - y0 + 1);
+    _write_at(*this, x0, y0, stroke.cell, x1 - x0 + 1, y1 - y0 + 1);
+}
+
 byte Map::at_bnd(const int x, const int y) const {
-    if (x <= 0 || x >= this->WIDTH - 1
-        || y <= 0 || y >= this->HEIGHT - 1) {
+    if (is_border(x, y)) {
         return CellType::WALL;
     }
-    else return data.at(x + y * this->WIDTH);
+    else return data[x + y * this->WIDTH];
+}
+
+bool Map::is_wall(const int x, const int y) const {
+    if (uint(x) >= uint(WIDTH) || uint(y) >= uint(HEIGHT)) {
+        return true;
+    }
+    return (_walls[y * ROW_WORDS + x / 64] >> (x % 64)) & 1;
+}
+
+int Map::distance(const int x, const int y) const {
+    if (uint(x) >= uint(WIDTH) || uint(y) >= uint(HEIGHT)) {
+        return -1;
+    }
+    return _sdf[x + y * WIDTH];
+}
+
+bool Map::save(c_str path) const {
+    map_file::Header header = {
+        .width  = WIDTH,
+        .height = HEIGHT,
+        .start  = {std::get<0>(start_point), std::get<1>(start_point)},
+        .finish = {std::get<0>(finish_point), std::get<1>(finish_point)},
+        .flags  = byte((start_initialised  ? map_file::HAS_START  : 0)
+                     | (finish_initialised ? map_file::HAS_FINISH : 0)),
+    };
+    auto packed = map_stream::encode(*this);
+    if (!map_file::write(path, header, data.data(), packed)) {
+        return false;
+    }
+    LOG_DBG("Saved the map to {}", path);
+    return true;
+}
+
+bool Map::load(c_str path) {
+    map_file::Mapping file;
+    if (!file.open(path, WIDTH, HEIGHT)) {
+        return false;
+    }
+    // zero-copy, the cells are used straight from the mapping
+    _file = std::move(file);
+    data  = std::span<byte, SIZE>(_file.cells(), SIZE);
+
+    const auto &hdr = _file.header();
+    start_initialised  = hdr.flags & map_file::HAS_START;
+    finish_initialised = hdr.flags & map_file::HAS_FINISH;
+    start_point  = {hdr.start[0],  hdr.start[1]};
+    finish_point = {hdr.finish[0], hdr.finish[1]};
+    LOG_DBG("Loaded the map from {}", path);
+    return true;
+}
+
+std::span<const byte> Map::packed() const {
+    if (!_file.is_open()) return {};
+    return _file.packed();
 }
 
@@ -3,41 +3,108 @@
 
 #include <SDL2/SDL_events.h>
 #include <array>
+#include <span>
+#include <vector>
+#include "map_file.hpp"
 #include "math.hpp"
 #include "types.hpp"
 #include <SDL2/SDL_pixels.h>
 #include <SDL2/SDL_render.h>
-#include <vector>
 
 enum CellType: byte {
     EMPTY   = 0x00,
     WALL    = 0xff,
     START   = 0xf0,
     FINISH  = 0x0f,
+    // not streamed in yet, solid until it is
+    UNKNOWN = 0x80,
+};
+
+// cells the player collides with
+inline bool is_solid(byte cell) {
+    return cell == CellType::WALL || cell == CellType::UNKNOWN;
+}
+
+// a size x size brush stroke at x, y, drawn the same on every peer
+struct Stroke {
+    uint        lamport     = 0;    // drawn in (lamport, player_num) order
+    byte        player_num  = 0;
+    int         x, y;
+    CellType    cell;
+    int         size;
 };
 
 struct Map {
+    // result of a swept query through the wall grid
+    struct Hit {
+        bool    hit;
+        int     x, y;               // last free cell on the path, the end cell if nothing was hit
+        int     cell_x, cell_y;     // the wall cell which was hit
+        int     normal_x, normal_y; // normal of the crossed cell face, 0 if nothing was hit
+    };
+
     static constexpr int WIDTH  = 800;
     static constexpr int HEIGHT = 600;
     static constexpr int SIZE   = WIDTH * HEIGHT;
-    std::array<byte, SIZE> data;
+    // points either to _storage or to the cells of a mapped map file
+    std::span<byte, SIZE> data;
     
     Map();
+    Map(const Map &) = delete;
+    Map &operator=(const Map &) = delete;
     byte at_bnd(const int x, const int y) const;
-    void handle_event(SDL_Event &event);
-    Vector2D refl_vector(Vector2D const &vect, const float x, const float y) const;
+    // same as is_solid(at_bnd(x, y)), but only touches the wall bitset
+    bool is_wall(const int x, const int y) const;
+    // signed distance to the closest wall in cells (chebyshev), capped at SDF_MAX,
+    // negative inside walls: the distance to the closest free cell
+    int distance(const int x, const int y) const;
+    // the brush strokes are appended to strokes, not drawn
+    void handle_event(SDL_Event &event, std::vector<Stroke> &strokes);
+    // draws the stroke, only the part of it within [x0, x1] x [y0, y1] if given
+    void apply(const Stroke &stroke);
+    void apply(const Stroke &stroke, int x0, int y0, int x1, int y1);
+    // walks every cell the segment (x, y) -> (x + dx, y + dy) crosses (Amanatides-Woo)
+    // and stops at the first wall, positions are cell coordinates like Player::pos
+    Hit sweep(const int x, const int y, const Real dx, const Real dy) const;
 
     std::tuple<int, int> start_point;
     std::tuple<int, int> finish_point;
 
     bool start_initialised  = false;
     bool finish_initialised = false;
+    // bumped whenever cells change, derived data compares it to rebuild
+    u64  revision           = 0;
     
-    void update(std::vector<byte> new_map);
+    // refreshes the texture and start / finish points after data was replaced
+    void update();
+    // refreshes the texture, walls and fields of [x0, x1] x [y0, y1] after
+    // its cells were replaced, start / finish points are left alone
+    void update(int x0, int y0, int x1, int y1);
+    // sets every cell and refreshes the whole map
+    void fill(CellType cell);
+
+    // saves the map in the map_file format
+    bool save(c_str path) const;
+    // maps the file in place of data, the cells are not copied
+    bool load(c_str path);
+    // packed map stream of the loaded file, empty if the map wasn't loaded
+    std::span<const byte> packed() const;
 
     SDL_Texture *_texture   = nullptr;
 	SDL_Renderer *_renderer = nullptr;
+    // 1 bit per cell, solid cells and the border at_bnd treats as walls,
+    // kept in sync by _write_at and update
+    static constexpr int ROW_WORDS = (WIDTH + 63) / 64;
+    std::array<u64, ROW_WORDS * HEIGHT> _walls;
+
+    // distance field, rebuilt by update and only around the
+    // dirty rectangle after _write_at
+    static constexpr int SDF_MAX = 16;
+    std::array<int8_t, SIZE> _sdf;
 private:
+    std::array<byte, SIZE>  _storage;
+    map_file::Mapping       _file;
+
     bool        _is_drawing = false;
     CellType    _brush_type = CellType::EMPTY;
 };
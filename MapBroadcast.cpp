@@ -0,0 +1,210 @@
+#include "MapBroadcast.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// NACKs crossing a repair in flight don't send it again
+static constexpr double REPAIR_HOLDOFF = 0.05;
+
+uint segment_count(size_t size) {
+    return std::max<uint>(1, (size + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+}
+
+uint group_first(uint group) {
+    return group * FEC_GROUP;
+}
+
+uint group_end(uint group, uint segment_count) {
+    return std::min(segment_count, group_first(group) + FEC_GROUP);
+}
+
+void Pacer::_refill(double now) {
+    _tokens = std::min(burst, _tokens + (now - _last) * rate);
+    _last = now;
+}
+
+bool Pacer::try_take(size_t bytes, double now) {
+    _refill(now);
+    if (_tokens < double(bytes)) return false;
+    _tokens -= double(bytes);
+    return true;
+}
+
+double Pacer::ready_at(size_t bytes, double now) const {
+    const double tokens = std::min(burst, _tokens + (now - _last) * rate);
+    if (tokens >= double(bytes)) return now;
+    return now + (double(bytes) - tokens) / rate;
+}
+
+// ---------------------------- sender ----------------------------
+
+void BroadcastSender::start(const byte *data, size_t size) {
+    _data   = data;
+    _size   = size;
+    _next   = 0;
+    _pending = 0;
+    const uint count = ::segment_count(size);
+    const uint groups = (count + FEC_GROUP - 1) / FEC_GROUP;
+    _sent_at.assign(count, 0);
+    _needed.assign(count, false);
+    _parity_sent_at.assign(groups, 0);
+    _parity_needed.assign(groups, false);
+
+    _parity.assign(groups * SEGMENT_SIZE, 0);
+    for (uint i = 0; i < count; ++i) {
+        byte *parity = _parity.data() + i / FEC_GROUP * SEGMENT_SIZE;
+        for (byte b: segment(i)) *parity++ ^= b;
+    }
+}
+
+std::span<const byte> BroadcastSender::segment(uint index) const {
+    const size_t begin = size_t(index) * SEGMENT_SIZE;
+    const size_t end = std::min(_size, begin + SEGMENT_SIZE);
+    return {_data + begin, end - begin};
+}
+
+std::span<const byte> BroadcastSender::parity(uint group) const {
+    // as long as the group's first segment
+    return {_parity.data() + group * SEGMENT_SIZE, segment(group_first(group)).size()};
+}
+
+bool BroadcastSender::next(Send &send) const {
+    if (!active()) return false;
+    if (_pending > 0) {
+        for (uint g = 0; g < group_count(); ++g) {
+            if (_parity_needed[g]) {
+                send = {.parity = true, .index = g};
+                return true;
+            }
+            for (uint i = group_first(g); i < group_end(g, segment_count()); ++i) {
+                if (!_needed[i]) continue;
+                send = {.parity = false, .index = i};
+                return true;
+            }
+        }
+    }
+    if (_next < segment_count()) {
+        send = {.parity = false, .index = _next};
+        return true;
+    }
+    return false;
+}
+
+void BroadcastSender::on_sent(Send send, double now) {
+    auto &needed = send.parity ? _parity_needed : _needed;
+    auto &sent_at = send.parity ? _parity_sent_at : _sent_at;
+    if (send.index >= sent_at.size()) return;
+    if (needed[send.index]) {
+        needed[send.index] = false;
+        --_pending;
+    }
+    sent_at[send.index] = now;
+    if (!send.parity && send.index == _next) ++_next;
+}
+
+void BroadcastSender::_need(bool parity, uint index, double now) {
+    auto &needed = parity ? _parity_needed : _needed;
+    const auto &sent_at = parity ? _parity_sent_at : _sent_at;
+    if (needed[index] || sent_at[index] + REPAIR_HOLDOFF > now) return;
+    needed[index] = true;
+    ++_pending;
+}
+
+void BroadcastSender::on_nack(uint first, u64 mask, double now) {
+    if (!active()) return;
+    // what isn't sent yet is still coming in the first pass
+    const uint end = std::min(_next, first + 1 + NACK_BITS);
+    auto missing = [&](uint i) {
+        return i == first || (i > first && mask >> (i - first - 1) & 1);
+    };
+    for (uint g = first / FEC_GROUP; g < group_count() && group_first(g) < end; ++g) {
+        const uint g_end = group_end(g, segment_count());
+        uint lost = 0;
+        for (uint i = std::max(first, group_first(g)); i < std::min(g_end, end); ++i) {
+            lost += missing(i);
+        }
+        // the parity repairs the group when it is all that's missing
+        if (lost == 1 && g_end <= end) {
+            _need(true, g, now);
+            continue;
+        }
+        for (uint i = std::max(first, group_first(g)); i < std::min(g_end, end); ++i) {
+            if (missing(i)) _need(false, i, now);
+        }
+    }
+}
+
+// --------------------------- receiver ---------------------------
+
+void BroadcastReceiver::start(size_t size) {
+    _count = ::segment_count(size);
+    _first = 0;
+    _buffer.assign(size, 0);
+    _received.assign(_count, false);
+    const uint groups = (_count + FEC_GROUP - 1) / FEC_GROUP;
+    _parity.assign(groups * SEGMENT_SIZE, 0);
+    _has_parity.assign(groups, false);
+}
+
+size_t BroadcastReceiver::segment_size(uint index) const {
+    const size_t begin = size_t(index) * SEGMENT_SIZE;
+    return std::min(_buffer.size() - std::min(begin, _buffer.size()), SEGMENT_SIZE);
+}
+
+bool BroadcastReceiver::on_segment(uint index, const byte *data, size_t size,
+                                   std::vector<uint> &arrived) {
+    if (index >= _count || _received[index]) return false;
+    if (size != segment_size(index)) return false;
+    memcpy(_buffer.data() + size_t(index) * SEGMENT_SIZE, data, size);
+    _received[index] = true;
+    arrived.push_back(index);
+    _recover(index / FEC_GROUP, arrived);
+    while (_first < _count && _received[_first]) ++_first;
+    return true;
+}
+
+bool BroadcastReceiver::on_parity(uint group, const byte *data, size_t size,
+                                  std::vector<uint> &arrived) {
+    if (group >= _has_parity.size() || _has_parity[group]) return false;
+    if (size != segment_size(group_first(group))) return false;
+    memcpy(_parity.data() + group * SEGMENT_SIZE, data, size);
+    _has_parity[group] = true;
+    _recover(group, arrived);
+    while (_first < _count && _received[_first]) ++_first;
+    return true;
+}
+
+void BroadcastReceiver::_recover(uint group, std::vector<uint> &arrived) {
+    if (!_has_parity[group]) return;
+    int lost = -1;
+    for (uint i = group_first(group); i < group_end(group, _count); ++i) {
+        if (_received[i]) continue;
+        if (lost >= 0) return;
+        lost = i;
+    }
+    if (lost < 0) return;
+
+    // the parity XOR every other segment of the group
+    byte *out = _buffer.data() + size_t(lost) * SEGMENT_SIZE;
+    const byte *parity = _parity.data() + group * SEGMENT_SIZE;
+    const size_t size = segment_size(lost);
+    memcpy(out, parity, size);
+    for (uint i = group_first(group); i < group_end(group, _count); ++i) {
+        if (uint(lost) == i) continue;
+        const byte *in = _buffer.data() + size_t(i) * SEGMENT_SIZE;
+        const size_t n = std::min(size, segment_size(i));
+        for (size_t b = 0; b < n; ++b) out[b] ^= in[b];
+    }
+    _received[lost] = true;
+    arrived.push_back(lost);
+}
+
+u64 BroadcastReceiver::mask() const {
+    u64 mask = 0;
+    for (uint bit = 0; bit < NACK_BITS; ++bit) {
+        const uint i = _first + 1 + bit;
+        if (i >= _count) break;
+        if (!_received[i]) mask |= u64(1) << bit;
+    }
+    return mask;
+}
@@ -0,0 +1,113 @@
+#ifndef ADHTP_MAP_BROADCAST_HDR
+#define ADHTP_MAP_BROADCAST_HDR
+
+#include <span>
+#include <vector>
+
+#include "types.hpp"
+
+/* reliable transfer of a fixed buffer to any number of receivers    *
+ * at once, the buffer is cut into numbered segments broadcast once, *
+ * receivers NACK only the ones they miss and the repairs are        *
+ * broadcast as well, so the airtime doesn't grow with the players   *
+ * the transport is up to the caller, nothing here touches a socket  */
+
+constexpr size_t SEGMENT_SIZE   = 1024;
+// bits of the mask after the first missing segment
+constexpr uint   NACK_BITS      = 64;
+/* segments covered by one XOR parity segment, a single parity  *
+ * repairs a different lost segment of the group at every peer  */
+constexpr uint   FEC_GROUP      = 8;
+
+// segments of a buffer, an empty one is still one (empty) segment
+uint segment_count(size_t size);
+// [first, end) segments of the group
+uint group_first(uint group);
+uint group_end(uint group, uint segment_count);
+
+/* token bucket shared by every sender, the wireless medium is shared *
+ * as well, a loss doesn't slow it down like TCP's congestion control *
+ * would, on a lossy link most losses aren't congestion               */
+struct Pacer {
+    double  rate    = 512 * 1024;           // bytes per second
+    double  burst   = 16 * SEGMENT_SIZE;    // bytes
+
+    bool try_take(size_t bytes, double now);
+    // when `bytes` will be available
+    double ready_at(size_t bytes, double now) const;
+
+private:
+    double  _tokens = 0;
+    double  _last   = 0;
+    void _refill(double now);
+};
+
+struct BroadcastSender {
+    // a data segment or the parity of a group
+    struct Send {
+        bool    parity;
+        uint    index;      // segment or group
+    };
+
+    // not copied, the data has to outlive the transfer
+    void start(const byte *data, size_t size);
+    bool active() const { return _data != nullptr; }
+
+    uint segment_count() const { return _sent_at.size(); }
+    uint group_count() const { return _parity_sent_at.size(); }
+    std::span<const byte> segment(uint index) const;
+    // XOR of the group's segments, the short last one zero padded
+    std::span<const byte> parity(uint group) const;
+    size_t size() const { return _size; }
+
+    // what to broadcast next, repairs before the first pass goes on,
+    // false if everything was sent and nobody is missing anything
+    bool next(Send &send) const;
+    void on_sent(Send send, double now);
+    // a receiver misses `first` and every segment of the mask, bit i is first + 1 + i
+    void on_nack(uint first, u64 mask, double now);
+
+private:
+    const byte          *_data  = nullptr;
+    size_t              _size   = 0;
+    std::vector<byte>   _parity;
+    std::vector<double> _sent_at;           // 0 - never sent
+    std::vector<double> _parity_sent_at;
+    std::vector<bool>   _needed;            // NACKed and not repaired yet
+    std::vector<bool>   _parity_needed;
+    uint                _next   = 0;        // first never sent
+    uint                _pending = 0;       // needed segments and parities
+
+    void _need(bool parity, uint index, double now);
+};
+
+struct BroadcastReceiver {
+    void start(size_t size);
+    bool active() const { return _count > 0; }
+    bool done() const { return active() && _first == _count; }
+
+    // copies the segment in, false for duplicates and bad segments
+    // it and any segment recovered thanks to it are added to arrived
+    bool on_segment(uint index, const byte *data, size_t size, std::vector<uint> &arrived);
+    // keeps the parity, recovers the group's one missing segment with it
+    bool on_parity(uint group, const byte *data, size_t size, std::vector<uint> &arrived);
+    uint segment_count() const { return _count; }
+    size_t segment_size(uint index) const;
+    uint first_missing() const { return _first; }
+    // bit i - segment first_missing() + 1 + i is missing
+    u64 mask() const;
+
+    const std::vector<byte>& data() const { return _buffer; }
+
+private:
+    std::vector<byte>   _buffer;
+    std::vector<bool>   _received;
+    std::vector<byte>   _parity;
+    std::vector<bool>   _has_parity;
+    uint                _count  = 0;
+    uint                _first  = 0;
+
+    void _recover(uint group, std::vector<uint> &arrived);
+};
+
+#endif // ADHTP_MAP_BROADCAST_HDR
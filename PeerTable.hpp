@@ -0,0 +1,88 @@
+#ifndef ADHTP_PEER_TABLE_HDR
+#define ADHTP_PEER_TABLE_HDR
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "types.hpp"
+
+/* flat table of peers indexed directly by the player number       *
+ * a dense list of the active numbers keeps iteration contiguous   *
+ * player number 0 is never a peer, it stands for "none"          */
+template <class T>
+struct PeerTable {
+    static constexpr size_t SLOTS   = 256;
+
+    struct Entry {
+        byte    num;
+        T       &value;
+    };
+
+    struct Iterator {
+        PeerTable   *table;
+        size_t      i;
+
+        Entry operator*() const {
+            byte num = table->_active[i];
+            return {num, table->_slots[num]};
+        }
+        Iterator& operator++() { ++i; return *this; }
+        bool operator!=(const Iterator &other) const { return i != other.i; }
+    };
+
+    Iterator begin()    { return {this, 0}; }
+    Iterator end()      { return {this, _count}; }
+
+    size_t size() const { return _count; }
+
+    bool contains(byte num) const {
+        return num != 0 && _present[num];
+    }
+
+    // nullptr if the peer isn't in the table
+    T* find(byte num) {
+        return contains(num) ? &_slots[num] : nullptr;
+    }
+
+    T& at(byte num) {
+        return _slots[num];
+    }
+
+    // adds a default constructed peer if missing
+    T& operator[](byte num) {
+        return contains(num) ? _slots[num] : emplace(num);
+    }
+
+    // constructs the peer in place, an existing one is left untouched
+    template <class... Args>
+    T& emplace(byte num, Args&&... args) {
+        if (contains(num)) return _slots[num];
+        std::destroy_at(&_slots[num]);
+        std::construct_at(&_slots[num], std::forward<Args>(args)...);
+        _present[num]   = true;
+        _index[num]     = _count;
+        _active[_count] = num;
+        ++_count;
+        return _slots[num];
+    }
+
+    // swaps the last active number into the removed one's place
+    void erase(byte num) {
+        if (!contains(num)) return;
+        byte last = _active[--_count];
+        _active[_index[num]] = last;
+        _index[last] = _index[num];
+        _present[num] = false;
+    }
+
+private:
+    std::array<T, SLOTS>    _slots      = {};
+    std::array<bool, SLOTS> _present    = {};
+    std::array<byte, SLOTS> _index      = {};   // position in _active
+    std::array<byte, SLOTS> _active     = {};   // dense list of present numbers
+    size_t                  _count      = 0;
+};
+
+#endif //ADHTP_PEER_TABLE_HDR
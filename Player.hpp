@@ -16,6 +16,14 @@ enum Direction {
     Right,
 };
 
+// what the player does in one simulation step, the others simulate it from this
+struct Input {
+    Direction   direction   = None;
+    bool        jump        = false;
+
+    bool operator==(const Input&) const = default;
+};
+
 struct Player {
     const struct {
         int WIDTH   = 8;
@@ -23,10 +31,14 @@ struct Player {
     } SIZE;
 
     // position
-    struct {
+    struct Position {
         int x;
         int y;
+
+        bool operator==(const Position&) const = default;
     } pos;
+    // position before the last simulation step, for render interpolation
+    Position prev_pos;
 
     // velocity
     Vector2D vel = Vector2D(0, 0);
@@ -37,19 +49,35 @@ struct Player {
 
     bool ready_to_play = false;
     byte player_num;
-    
-    // should predict the movement
-    bool should_predict;     
+
     bool has_jumped = false;
-    bool needs_jump = false;
+    // the jump key went down since the last take_input
+    bool jump_pressed = false;
+
+    // what a simulation step starts from, saved to roll back to
+    struct State {
+        Position    pos         = {0, 0};
+        Vector2D    vel         = Vector2D(0, 0);
+        bool        has_jumped  = false;
+
+        bool operator==(const State&) const = default;
+    };
+    State state() const;
+    void restore(const State &state);
 
     // update movement information (sent through packets)
-    void set_new_data(int x, int y, float vel_x, float vel_y);
-    // move the player based on the movement information
-    void update_position(Map &map);
+    void set_new_data(int x, int y, Real vel_x, Real vel_y);
+    // one simulation step driven by the input
+    void step(Map &map, Input input);
+    // moves to the state a step with the input ended in, stepped in a PlayerBatch
+    void end_step(const State &next, Input input);
+    // the keys' input for the next step
+    Input take_input();
 
     void handle_event(SDL_Event& event);
-    void render(SDL_Renderer* renderer) const;
+    // alpha - fraction of the simulation step elapsed since the last update
+    // outline - only the border is drawn, what's behind stays visible
+    void render(SDL_Renderer* renderer, float alpha, bool outline = false) const;
 };
 
 #endif // ADHTP_PLAYER_HDR
@@ -0,0 +1,137 @@
+#include "PlayerBatch.hpp"
+
+#include <type_traits>
+
+static constexpr int HEIGHT = std::remove_cv_t<decltype(Player::SIZE)>{}.HEIGHT;
+
+static bool is_on_ground(const Map &map, int x, int y) {
+    return (!map.is_wall(x, y)
+        && map.is_wall(x, y + 1));
+}
+
+static bool is_colliding(const Map &map, int x, int y) {
+    return
+        (map.is_wall(x + 1, y) &&
+        map.is_wall(x - 1, y) &&
+        map.is_wall(x, y - 1) &&
+        map.is_wall(x, y + 1));
+}
+
+static bool unstuck_walls(const Map &map, int x, int &y) {
+    for (int off = 0; off < HEIGHT; ++off) {
+        if (is_on_ground(map, x, y - off)) {
+            y = y - off;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool move_down(const Map &map, int x, int &y) {
+    for (int off = 0; off > -HEIGHT; --off) {
+        if (is_on_ground(map, x, y - off)) {
+            y = y - off;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void move_walking(const Map &map, int &x, int &y, Real &vel_x, Real &vel_y) {
+    x = (Real(x) + vel_x + Real(0.5)).floor();
+    vel_y = 0;
+
+    while (vel_x != 0) {
+        if (is_on_ground(map, x, y)) return;
+        if (unstuck_walls(map, x, y)) return;
+        if (move_down(map, x, y)) return;
+        vel_x /= 2;
+    }
+}
+
+static void move_flight(const Map &map, int &x, int &y, Real &vel_x, Real &vel_y) {
+    vel_y += PlayerBatch::GRAVITY;
+
+    // one pass through every cell on the way, nothing gets tunneled through
+    const auto hit = map.sweep(x, y, vel_x, vel_y);
+    x = hit.x;
+    y = hit.y;
+    if (hit.hit) {
+        // stop moving into the surface, keep sliding along it
+        if (hit.normal_x != 0) vel_x = 0;
+        if (hit.normal_y != 0) vel_y = 0;
+    }
+}
+
+void PlayerBatch::clear() {
+    x.clear();
+    y.clear();
+    vel_x.clear();
+    vel_y.clear();
+    direction.clear();
+    jump.clear();
+    has_jumped.clear();
+}
+
+size_t PlayerBatch::add(const Player::State &state, Input input) {
+    x.push_back(state.pos.x);
+    y.push_back(state.pos.y);
+    vel_x.push_back(state.vel.x);
+    vel_y.push_back(state.vel.y);
+    direction.push_back(input.direction);
+    jump.push_back(input.jump);
+    has_jumped.push_back(state.has_jumped);
+    return size() - 1;
+}
+
+Player::State PlayerBatch::state(size_t i) const {
+    return {
+        .pos        = {x[i], y[i]},
+        .vel        = Vector2D(vel_x[i], vel_y[i]),
+        .has_jumped = bool(has_jumped[i]),
+    };
+}
+
+void PlayerBatch::step(const Map &map) {
+    const uint n = size();
+    _needs_jump.resize(n);
+    _old_x.assign(x.begin(), x.end());
+    _old_y.assign(y.begin(), y.end());
+
+    // jumps and the horizontal velocity, selects only
+    for (uint i = 0; i < n; ++i) {
+        const bool jumps = jump[i] && !has_jumped[i];
+        vel_y[i]        = jumps ? vel_y[i] - JUM_CAP : vel_y[i];
+        has_jumped[i]   = has_jumped[i] | jumps;
+        _needs_jump[i]  = jumps;
+
+        const Real v = vel_x[i];
+        const Real left     = v <= -VEL_CAP ? -VEL_CAP : v - ACCEL;
+        const Real right    = v >= VEL_CAP ? VEL_CAP : v + ACCEL;
+        const Real coast    = v > -REST && v < REST ? Real(0) : v * DECCEL;
+        vel_x[i] = direction[i] == Left ? left : direction[i] == Right ? right : coast;
+    }
+
+    // every player's map probe before any of them moves
+    _walking.clear();
+    _flying.clear();
+    for (uint i = 0; i < n; ++i) {
+        if (!_needs_jump[i] && is_on_ground(map, x[i], y[i])) _walking.push_back(i);
+        else if (!is_colliding(map, x[i], y[i])) _flying.push_back(i);
+    }
+    for (uint i: _walking) move_walking(map, x[i], y[i], vel_x[i], vel_y[i]);
+    for (uint i: _flying)  move_flight(map, x[i], y[i], vel_x[i], vel_y[i]);
+
+    // landed, or stuck in a wall and put back where it was
+    for (uint i = 0; i < n; ++i) {
+        if (is_on_ground(map, x[i], y[i])) {
+            has_jumped[i] = false;
+        } else if (map.is_wall(x[i], y[i])) {
+            vel_x[i]        = 0;
+            vel_y[i]        = 0;
+            x[i]            = _old_x[i];
+            y[i]            = _old_y[i];
+            has_jumped[i]   = false;
+        }
+    }
+}
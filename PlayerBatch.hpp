@@ -0,0 +1,57 @@
+#ifndef ADHTP_PLAYER_BATCH_HDR
+#define ADHTP_PLAYER_BATCH_HDR
+
+#include <vector>
+
+#include "types.hpp"
+#include "math.hpp"
+#include "Map.hpp"
+#include "Player.hpp"
+
+/* the kinematics of many players in parallel arrays, stepped together  *
+ * the input and velocity passes run over whole arrays without branches *
+ * and the map is probed for every player before the per-player walking *
+ * and flying, this is the only implementation of the player physics,   *
+ * Player::step is a batch of one                                       */
+struct PlayerBatch {
+    static constexpr Real JUM_CAP  = Real(5.0);
+    static constexpr Real VEL_CAP  = Real(2.0); //cap
+    static constexpr Real ACCEL    = Real(0.3);
+    static constexpr Real DECCEL   = Real(0.85);
+    static constexpr Real GRAVITY  = Real(0.2);
+    // slower than this the player stops
+    static constexpr Real REST     = Real(0.01);
+    // cells a jump from the ground rises
+    static constexpr int  JUMP_HEIGHT = [] {
+        Real vel = -JUM_CAP, rise = 0;
+        for (vel += GRAVITY; vel < 0; vel += GRAVITY) rise -= vel;
+        return rise.floor();
+    }();
+
+    std::vector<int>    x;
+    std::vector<int>    y;
+    std::vector<Real>   vel_x;
+    std::vector<Real>   vel_y;
+    std::vector<byte>   direction;
+    std::vector<byte>   jump;           // the input's
+    std::vector<byte>   has_jumped;
+
+    size_t size() const { return x.size(); }
+    void clear();
+    // the player's index in the batch
+    size_t add(const Player::State &state, Input input);
+    Player::State state(size_t i) const;
+
+    // one simulation step of every player with the inputs added
+    void step(const Map &map);
+
+private:
+    // scratch of step, kept to not allocate every tick
+    std::vector<byte>   _needs_jump;
+    std::vector<int>    _old_x;
+    std::vector<int>    _old_y;
+    std::vector<uint>   _walking;
+    std::vector<uint>   _flying;
+};
+
+#endif // ADHTP_PLAYER_BATCH_HDR
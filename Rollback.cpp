@@ -0,0 +1,102 @@
+#include "Rollback.hpp"
+#include "PlayerBatch.hpp"
+
+#include <algorithm>
+
+void Rollback::reset() {
+    _slots.fill({});
+    _started    = false;
+    _offset     = INT64_MAX;
+    _next       = 1;
+    _rollback   = 0;
+    _synced     = 0;
+}
+
+void Rollback::_mispredicted(uint tick) {
+    if (_rollback == 0 || tick < _rollback) _rollback = tick;
+}
+
+void Rollback::on_input(uint tick, Input input, u64 local_tick) {
+    _offset = std::min(_offset, i64(local_tick) - i64(tick));
+
+    // kept before the start too, the state it starts from might be older
+    if (_started && tick + REACH < _next) return;
+    if (_started && tick >= _next + REACH) {
+        LOG_DBG("Rollback: input {} is too far ahead of tick {}, waiting for a state", tick, _next);
+        reset();
+    }
+    auto &slot = _slot(tick);
+    if (slot.input_tick == tick) return;
+    slot.input_tick = tick;
+    slot.input      = input;
+    // the state synced after it is right whatever the input was
+    if (_started && tick >= _synced && tick < _next && slot.used != input) _mispredicted(tick);
+}
+
+void Rollback::on_state(uint tick, const Player::State &state, u64 local_tick) {
+    _offset = std::min(_offset, i64(local_tick) - i64(tick));
+    const uint next = tick + 1;
+    if (_started && next < _synced) return;
+    if (_started && (next + REACH < _next || next >= _next + REACH)) {
+        LOG_DBG("Rollback: state of tick {} is too far from tick {}, restarting", tick, _next);
+        _started = false;
+    }
+    if (!_started) {
+        _started    = true;
+        _next       = next;
+        _rollback   = 0;
+    } else if (next < _next && _slot(next).before != state) {
+        LOG_DBG("Rollback: diverged before tick {}, going back", next);
+        _mispredicted(next);
+    }
+    // a state ahead of the simulation replaces it once it gets there
+    _synced         = next;
+    _synced_state   = state;
+}
+
+void Rollback::rewind(Player &player) {
+    if (!_started || _rollback == 0) return;
+    player.restore(_slot(_rollback).before);
+    _next       = _rollback;
+    _rollback   = 0;
+}
+
+bool Rollback::is_behind(u64 local_tick) const {
+    return _started && i64(_next) <= i64(local_tick) - _offset;
+}
+
+Input Rollback::next_input(Player &player) {
+    if (_next == _synced) player.restore(_synced_state);
+    auto &slot = _slot(_next);
+    const Input predicted = _slot(_next - 1).input_tick == _next - 1
+        ? _slot(_next - 1).input : _slot(_next - 1).used;
+    slot.used   = slot.input_tick == _next ? slot.input : predicted;
+    slot.before = player.state();
+    ++_next;
+    return slot.used;
+}
+
+void advance(std::span<Rollback *const> rollbacks, std::span<Player *const> players,
+             const Map &map, u64 local_tick) {
+    static PlayerBatch batch;
+    static std::vector<Input> inputs;
+    static std::vector<uint> stepped;
+    for (uint i = 0; i < rollbacks.size(); ++i) rollbacks[i]->rewind(*players[i]);
+
+    while (true) {
+        batch.clear();
+        inputs.clear();
+        stepped.clear();
+        for (uint i = 0; i < rollbacks.size(); ++i) {
+            if (!rollbacks[i]->is_behind(local_tick)) continue;
+            inputs.push_back(rollbacks[i]->next_input(*players[i]));
+            batch.add(players[i]->state(), inputs.back());
+            stepped.push_back(i);
+        }
+        if (stepped.empty()) break;
+        batch.step(map);
+        for (uint k = 0; k < stepped.size(); ++k) {
+            players[stepped[k]]->end_step(batch.state(k), inputs[k]);
+        }
+    }
+}
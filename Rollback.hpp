@@ -0,0 +1,63 @@
+#ifndef ADHTP_ROLLBACK_HDR
+#define ADHTP_ROLLBACK_HDR
+
+#include <array>
+#include <span>
+
+#include "types.hpp"
+#include "Map.hpp"
+#include "Player.hpp"
+
+/* a remote player simulated from its inputs instead of its positions *
+ * a tick whose input hasn't arrived yet repeats the previous one,    *
+ * once the real one arrives and differs, the player is put back to   *
+ * the state before that tick and simulated again up to the present   *
+ * the player's own state after one of its ticks starts it, and every *
+ * later one replaces what was simulated for it, whatever was lost    *
+ * ticks are the player's own, ours map to them by the smallest       *
+ * difference seen, the freshest input                                */
+struct Rollback {
+    static constexpr uint WINDOW = 256;
+    // inputs this far back can still be rolled back to, this far ahead be held
+    static constexpr uint REACH  = WINDOW / 2;
+
+    // the input of the player's tick arrived, local_tick is our tick now
+    void on_input(uint tick, Input input, u64 local_tick);
+    // the player's state after its tick arrived, simulated from there on
+    void on_state(uint tick, const Player::State &state, u64 local_tick);
+    // puts the player back to its first mispredicted tick, if there is one
+    void rewind(Player &player);
+    // its next tick is not past our tick yet
+    bool is_behind(u64 local_tick) const;
+    // the input of the player's next tick, its state is kept to roll back to
+    Input next_input(Player &player);
+    // false until the player's first state arrives, or once it fell too far behind
+    bool active() const { return _started; }
+    void reset();
+
+private:
+    struct Slot {
+        uint            input_tick  = 0;    // 0 - its input hasn't arrived
+        Input           input;
+        Input           used;               // the simulation went with this one
+        Player::State   before;
+    };
+    std::array<Slot, WINDOW> _slots;
+    bool    _started    = false;
+    i64     _offset     = INT64_MAX;    // our tick - the player's tick
+    uint    _next       = 1;    // the next tick to simulate
+    uint    _rollback   = 0;    // the first mispredicted tick, 0 - none
+    // the state the player's tick _synced - 1 ended in, its own
+    uint            _synced = 0;
+    Player::State   _synced_state;
+
+    Slot& _slot(uint tick) { return _slots[tick % WINDOW]; }
+    void _mispredicted(uint tick);
+};
+
+// simulates the players up to our tick, rolled back first where they were
+// mispredicted, every one still behind is stepped in the same batch
+void advance(std::span<Rollback *const> rollbacks, std::span<Player *const> players,
+             const Map &map, u64 local_tick);
+
+#endif // ADHTP_ROLLBACK_HDR
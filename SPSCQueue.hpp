@@ -0,0 +1,44 @@
+#ifndef ADHTP_SPSC_QUEUE_HDR
+#define ADHTP_SPSC_QUEUE_HDR
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/* lock-free single producer / single consumer ring buffer  *
+ * one thread may only push, the other one may only pop    */
+template <class T, size_t N>
+struct SPSCQueue {
+    static_assert(N > 1 && (N & (N - 1)) == 0, "capacity must be a power of two");
+    static constexpr size_t MASK = N - 1;
+
+    // producer side, fails when the queue is full
+    bool push(const T &item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        _buffer[tail & MASK] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, fails when the queue is empty
+    bool pop(T &item) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = _buffer[head & MASK];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // kept on separate cache lines so both ends don't false share
+    alignas(64) std::atomic<size_t> _head = 0;
+    alignas(64) std::atomic<size_t> _tail = 0;
+    alignas(64) std::array<T, N>    _buffer;
+};
+
+#endif //ADHTP_SPSC_QUEUE_HDR
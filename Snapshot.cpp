@@ -0,0 +1,59 @@
+#include "Snapshot.hpp"
+
+#include <algorithm>
+
+void extrapolate(const Snapshot &snapshot, double dt, float &x, float &y) {
+    const float t = float(std::clamp(dt, 0.0, MAX_EXTRAPOLATION));
+    x = snapshot.x + snapshot.vel_x * t;
+    y = snapshot.y + snapshot.vel_y * t;
+}
+
+void JitterBuffer::push(const Snapshot &snapshot) {
+    if (_count > 0) {
+        const auto &newest = _at(_count - 1);
+        if (snapshot.seq <= newest.seq) return;
+    }
+    if (_count == CAPACITY) {
+        _head = (_head + 1) % CAPACITY;
+        --_count;
+    }
+    auto &slot = _ring[(_head + _count) % CAPACITY];
+    slot = snapshot;
+    // packets drained in one poll share a timestamp, keep the timeline increasing
+    if (_count > 0) slot.time = std::max(slot.time, _at(_count - 1).time);
+    ++_count;
+}
+
+void JitterBuffer::clear() {
+    _head   = 0;
+    _count  = 0;
+}
+
+bool JitterBuffer::sample(double render_time, float &x, float &y) const {
+    if (_count == 0) return false;
+
+    const auto &oldest = _at(0);
+    if (render_time <= oldest.time) {
+        x = oldest.x;
+        y = oldest.y;
+        return true;
+    }
+
+    // newest snapshot before the render time, the buffer is short
+    size_t i = _count - 1;
+    while (i > 0 && _at(i).time > render_time) --i;
+
+    const auto &from = _at(i);
+    if (i + 1 < _count) {
+        const auto &to = _at(i + 1);
+        const double span = to.time - from.time;
+        const float t = span > 0 ? float((render_time - from.time) / span) : 1.f;
+        x = from.x + (to.x - from.x) * t;
+        y = from.y + (to.y - from.y) * t;
+        return true;
+    }
+
+    // ran out of snapshots, continue along the last known velocity
+    extrapolate(from, render_time - from.time, x, y);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef ADHTP_SNAPSHOT_HDR
+#define ADHTP_SNAPSHOT_HDR
+
+#include <array>
+
+#include "types.hpp"
+
+// the extrapolation stops after this long without packets (sec)
+constexpr double MAX_EXTRAPOLATION = 0.25;
+
+// state of a remote player as received in one Coord packet
+struct Snapshot {
+    uint    seq;
+    double  time;       // local receive (or send) time (sec)
+    float   x;
+    float   y;
+    float   vel_x;      // per second
+    float   vel_y;
+};
+
+// the motion receivers assume after a snapshot, until the next one arrives
+void extrapolate(const Snapshot &snapshot, double dt, float &x, float &y);
+
+/* per peer buffer of the most recent snapshots, ordered by seq       *
+ * the peer is drawn a fixed delay behind the receive timeline by     *
+ * interpolating between the two snapshots around that point, so      *
+ * uneven packet arrival doesn't show up as jitter                    *
+ * past the newest snapshot (a gap) the motion is extrapolated        */
+struct JitterBuffer {
+    static constexpr size_t CAPACITY = 32;
+
+    // stale and duplicate snapshots are dropped
+    void push(const Snapshot &snapshot);
+    void clear();
+    bool empty() const { return _count == 0; }
+
+    // position at `time` on the receive timeline (now - render delay)
+    // false while the buffer is empty
+    bool sample(double time, float &x, float &y) const;
+
+private:
+    std::array<Snapshot, CAPACITY> _ring;
+    size_t  _head   = 0;    // index of the oldest snapshot
+    size_t  _count  = 0;
+
+    const Snapshot& _at(size_t i) const { return _ring[(_head + i) % CAPACITY]; }
+};
+
+#endif // ADHTP_SNAPSHOT_HDR
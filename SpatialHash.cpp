@@ -0,0 +1,22 @@
+#include "SpatialHash.hpp"
+
+void SpatialHash::clear() {
+    _added.clear();
+}
+
+void SpatialHash::add(uint id, int x, int y) {
+    _added.push_back({id, x, y});
+}
+
+void SpatialHash::build() {
+    // count the entries of every cell, the prefix sums are where they start
+    _start.fill(0);
+    for (const auto &e: _added) ++_start[_cell(e.x, e.y) + 1];
+    for (int c = 0; c < COLS * ROWS; ++c) _start[c + 1] += _start[c];
+
+    // every entry to the next free slot of its cell, in the order added
+    _sorted.resize(_added.size());
+    std::array<uint, COLS * ROWS> next;
+    std::copy(_start.begin(), _start.end() - 1, next.begin());
+    for (const auto &e: _added) _sorted[next[_cell(e.x, e.y)]++] = e;
+}
@@ -0,0 +1,60 @@
+#ifndef ADHTP_SPATIAL_HASH_HDR
+#define ADHTP_SPATIAL_HASH_HDR
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <vector>
+
+#include "types.hpp"
+#include "Map.hpp"
+
+/* points bucketed into a uniform grid over the map, rebuilt from      *
+ * scratch with a counting sort into one flat array, a query visits    *
+ * only the cells its box touches, not every point                     */
+struct SpatialHash {
+    // a few players wide, most queries touch 4 cells
+    static constexpr int CELL   = 32;
+    static constexpr int COLS   = (Map::WIDTH  + CELL - 1) / CELL;
+    static constexpr int ROWS   = (Map::HEIGHT + CELL - 1) / CELL;
+
+    struct Entry {
+        uint    id;
+        int     x, y;
+    };
+
+    void clear();
+    void add(uint id, int x, int y);
+    // sorts what was added into the cells, queries see only what was built
+    void build();
+    size_t size() const { return _sorted.size(); }
+
+    // visits every entry no further than radius from x, y on both axes
+    template <typename Visit>
+    void query(int x, int y, int radius, Visit &&visit) const {
+        const int col0 = _col(x - radius), col1 = _col(x + radius);
+        const int row0 = _row(y - radius), row1 = _row(y + radius);
+        for (int row = row0; row <= row1; ++row) {
+            // the cells of a row are next to each other in the array
+            const uint first    = _start[row * COLS + col0];
+            const uint end      = _start[row * COLS + col1 + 1];
+            for (uint i = first; i < end; ++i) {
+                const Entry &e = _sorted[i];
+                if (std::abs(e.x - x) <= radius && std::abs(e.y - y) <= radius) visit(e);
+            }
+        }
+    }
+
+private:
+    std::vector<Entry>              _added;
+    std::vector<Entry>              _sorted;
+    // first entry of every cell, the last one is the end of the array
+    std::array<uint, COLS * ROWS + 1> _start = {};
+
+    // outside the map is clamped into the border cells
+    static int _col(int x) { return std::clamp(x, 0, Map::WIDTH  - 1) / CELL; }
+    static int _row(int y) { return std::clamp(y, 0, Map::HEIGHT - 1) / CELL; }
+    static int _cell(int x, int y) { return _row(y) * COLS + _col(x); }
+};
+
+#endif // ADHTP_SPATIAL_HASH_HDR
@@ -0,0 +1,110 @@
+#include "StrokeLog.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static bool before(const Stroke &a, const Stroke &b) {
+    if (a.lamport != b.lamport) return a.lamport < b.lamport;
+    return a.player_num < b.player_num;
+}
+
+void StrokeLog::start(const Map &map) {
+    _strokes.clear();
+    _clock              = 0;
+    _base.assign(map.data.begin(), map.data.end());
+    _base_start         = map.start_initialised;
+    _base_finish        = map.finish_initialised;
+    _base_start_point   = map.start_point;
+    _base_finish_point  = map.finish_point;
+}
+
+uint StrokeLog::tick() {
+    return ++_clock;
+}
+
+bool StrokeLog::_is_skipped(size_t pos) const {
+    const auto cell = _strokes[pos].cell;
+    if (cell == CellType::START && _base_start) return true;
+    if (cell == CellType::FINISH && _base_finish) return true;
+    if (cell != CellType::START && cell != CellType::FINISH) return false;
+    for (size_t i = 0; i < pos; ++i) {
+        if (_strokes[i].cell == cell) return true;
+    }
+    return false;
+}
+
+void StrokeLog::_draw(const Stroke &stroke, Map &map) const {
+    map.apply(stroke);
+    if (stroke.cell == CellType::START) {
+        map.start_point = {stroke.x, stroke.y};
+        map.start_initialised = true;
+    }
+    if (stroke.cell == CellType::FINISH) {
+        map.finish_point = {stroke.x, stroke.y};
+        map.finish_initialised = true;
+    }
+}
+
+bool StrokeLog::add(const Stroke &stroke, Map &map) {
+    _clock = std::max(_clock, stroke.lamport);
+    auto it = std::lower_bound(_strokes.begin(), _strokes.end(), stroke, before);
+    if (it != _strokes.end() && !before(stroke, *it)) return false;
+    const size_t pos = it - _strokes.begin();
+    _strokes.insert(it, stroke);
+
+    if (stroke.cell == CellType::START || stroke.cell == CellType::FINISH) {
+        // it takes the place of a later one, which was drawn already
+        for (size_t i = pos + 1; i < _strokes.size(); ++i) {
+            if (_strokes[i].cell != stroke.cell) continue;
+            _replay(map);
+            return true;
+        }
+    }
+    if (_is_skipped(pos)) return true;
+    _draw(stroke, map);
+
+    // the later strokes win where they overlap it
+    const int x0 = stroke.x, x1 = stroke.x + stroke.size - 1;
+    const int y0 = stroke.y, y1 = stroke.y + stroke.size - 1;
+    for (size_t i = pos + 1; i < _strokes.size(); ++i) {
+        const auto &later = _strokes[i];
+        if (later.x > x1 || later.x + later.size - 1 < x0
+            || later.y > y1 || later.y + later.size - 1 < y0) continue;
+        if (_is_skipped(i)) continue;
+        map.apply(later, x0, y0, x1, y1);
+    }
+    return true;
+}
+
+void StrokeLog::_replay(Map &map) const {
+    LOG_DBG("Redrawing {} strokes", _strokes.size());
+    memcpy(map.data.data(), _base.data(), _base.size());
+    // cells only, the walls, fields and texture are rebuilt once at the end
+    for (size_t i = 0; i < _strokes.size(); ++i) {
+        if (_is_skipped(i)) continue;
+        const auto &s = _strokes[i];
+        const int x0 = std::max(s.x, 0), x1 = std::min(s.x + s.size, Map::WIDTH) - 1;
+        if (x0 > x1) continue;
+        for (int y = std::max(s.y, 0); y < std::min(s.y + s.size, Map::HEIGHT); ++y) {
+            memset(map.data.data() + x0 + y * Map::WIDTH, s.cell, x1 - x0 + 1);
+        }
+    }
+    map.update();
+
+    map.start_initialised   = _base_start;
+    map.finish_initialised  = _base_finish;
+    map.start_point         = _base_start_point;
+    map.finish_point        = _base_finish_point;
+    for (size_t i = 0; i < _strokes.size(); ++i) {
+        const auto &s = _strokes[i];
+        if (s.cell != CellType::START && s.cell != CellType::FINISH) continue;
+        if (_is_skipped(i)) continue;
+        if (s.cell == CellType::START) {
+            map.start_point = {s.x, s.y};
+            map.start_initialised = true;
+        } else {
+            map.finish_point = {s.x, s.y};
+            map.finish_initialised = true;
+        }
+    }
+}
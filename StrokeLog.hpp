@@ -0,0 +1,41 @@
+#ifndef ADHTP_STROKE_LOG_HDR
+#define ADHTP_STROKE_LOG_HDR
+
+#include <tuple>
+#include <vector>
+
+#include "Map.hpp"
+#include "types.hpp"
+
+/* every stroke of the drawing, ours and the other players', in     *
+ * lamport order, so every peer ends up with the same map no matter *
+ * in which order the strokes arrived: a late stroke is drawn and   *
+ * the later ones overlapping it are drawn over it again            *
+ * only the first START and FINISH count, later ones are skipped    */
+struct StrokeLog {
+    // the strokes are drawn over the map as it is now
+    void start(const Map &map);
+    // lamport time of a new local stroke
+    uint tick();
+    // draws the stroke in its place, false if it was added already
+    bool add(const Stroke &stroke, Map &map);
+    size_t size() const { return _strokes.size(); }
+
+private:
+    std::vector<Stroke>     _strokes;
+    uint                    _clock  = 0;
+
+    // the map before any stroke, for a full replay
+    std::vector<byte>       _base;
+    bool                    _base_start     = false;
+    bool                    _base_finish    = false;
+    std::tuple<int, int>    _base_start_point;
+    std::tuple<int, int>    _base_finish_point;
+
+    bool _is_skipped(size_t pos) const;
+    void _draw(const Stroke &stroke, Map &map) const;
+    // redraws the whole map from the base, a START / FINISH came in late
+    void _replay(Map &map) const;
+};
+
+#endif //ADHTP_STROKE_LOG_HDR
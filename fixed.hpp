@@ -0,0 +1,96 @@
+#ifndef ADHTP_FIXED_HDR
+#define ADHTP_FIXED_HDR
+
+#include <compare>
+#include <concepts>
+#include <cstdint>
+
+/* Q-format fixed point number, the value is raw / 2^Frac             *
+ * everything is integer arithmetic, so a simulation made of them     *
+ * gives the same bits with any compiler, flags or CPU                *
+ * the raw value is 64 bit, products of values up to 2^(31 - Frac)    *
+ * fit before the shift, physics values stay far below that           */
+template <int Frac>
+struct Fixed {
+    static_assert(Frac > 0 && Frac < 31);
+    static constexpr int        FRAC    = Frac;
+    static constexpr int64_t    ONE     = int64_t(1) << Frac;
+
+    int64_t raw = 0;
+
+    constexpr Fixed() = default;
+    // integers are exact, floats have to be converted explicitly
+    template <std::integral I>
+    constexpr Fixed(I value) : raw(int64_t(value) * ONE) {}
+    // rounded to the nearest step, meant for constants evaluated at compile time
+    constexpr explicit Fixed(double value)
+        : raw(int64_t(value * ONE + (value < 0 ? -0.5 : 0.5))) {}
+
+    static constexpr Fixed from_raw(int64_t raw) {
+        Fixed f;
+        f.raw = raw;
+        return f;
+    }
+    static constexpr Fixed max() { return from_raw(INT64_MAX / 4); }
+
+    // rounding towards negative infinity, like std::floor
+    constexpr int floor() const { return int(raw >> Frac); }
+    constexpr int round() const { return int((raw + ONE / 2) >> Frac); }
+    // for the wire and the screen, never fed back into the simulation
+    constexpr float to_float() const { return float(raw) / ONE; }
+
+    constexpr Fixed operator-() const { return from_raw(-raw); }
+    constexpr Fixed operator+(Fixed o) const { return from_raw(raw + o.raw); }
+    constexpr Fixed operator-(Fixed o) const { return from_raw(raw - o.raw); }
+    // rounded to nearest, a shift alone would drift negative values towards -1
+    constexpr Fixed operator*(Fixed o) const { return from_raw((raw * o.raw + ONE / 2) >> Frac); }
+    // truncated towards 0, like integer division, raw * ONE needs up to 64 + Frac bits
+    constexpr Fixed operator/(Fixed o) const {
+        return from_raw(int64_t(__int128(raw) * ONE / o.raw));
+    }
+    constexpr Fixed operator*(int n) const { return from_raw(raw * n); }
+    constexpr Fixed operator/(int n) const { return from_raw(raw / n); }
+
+    constexpr Fixed& operator+=(Fixed o) { return *this = *this + o; }
+    constexpr Fixed& operator-=(Fixed o) { return *this = *this - o; }
+    constexpr Fixed& operator*=(Fixed o) { return *this = *this * o; }
+    constexpr Fixed& operator/=(Fixed o) { return *this = *this / o; }
+    constexpr Fixed& operator*=(int n) { return *this = *this * n; }
+    constexpr Fixed& operator/=(int n) { return *this = *this / n; }
+
+    constexpr bool operator==(const Fixed&) const = default;
+    constexpr auto operator<=>(const Fixed&) const = default;
+};
+
+template <int Frac>
+constexpr Fixed<Frac> abs(Fixed<Frac> f) { return f.raw < 0 ? -f : f; }
+
+// floor of the square root, one bit at a time
+constexpr uint64_t isqrt(uint64_t n) {
+    uint64_t root = 0;
+    uint64_t bit = uint64_t(1) << 62;
+    while (bit > n) bit >>= 2;
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// negative values have no root, 0 is returned
+template <int Frac>
+constexpr Fixed<Frac> sqrt(Fixed<Frac> f) {
+    if (f.raw <= 0) return {};
+    return Fixed<Frac>::from_raw(int64_t(isqrt(uint64_t(f.raw) << Frac)));
+}
+
+static_assert(isqrt(0) == 0 && isqrt(15) == 3 && isqrt(16) == 4);
+static_assert(sqrt(Fixed<16>(2)).raw == 92681);
+static_assert((Fixed<16>(int64_t(1) << 40) / Fixed<16>(4)).raw == int64_t(1) << 54);
+
+#endif // ADHTP_FIXED_HDR
@@ -2,8 +2,9 @@
 #include <SDL2/SDL_pixels.h>
 #include <cstdlib>
 #include <cstring>
+#include <cmath>
 
-#include <unordered_map>
+#include <algorithm>
 #include <vector>
 #include <array>
 
@@ -14,20 +15,37 @@
 #include "types.hpp"
 #include "networking.hpp"
 #include "Player.hpp"
+#include "map_stream.hpp"
+#include "map_cache.hpp"
+#include "Bot.hpp"
+#include "FlowField.hpp"
+#include "SpatialHash.hpp"
+#include "PeerTable.hpp"
+#include "Snapshot.hpp"
+#include "StrokeLog.hpp"
+#include "Rollback.hpp"
 
 enum GameState {
     Initializing,   // network conf, sdl setup...       -> ---
     Drawing,        // drawing the map                  -> ---
     Connecting,     // trying to connect to all players -> HELLO
     Streaming,      // streaming the map to all users   -> ACK
-    Awaiting,       // Waiting for others               -> TCP
-    Ready,          // waiting untill the min(id) starts-> TCP
-    Playing,        // playing the game                 -> CoordSend
+    Awaiting,       // Waiting for others               -> MAP
+    Ready,          // waiting untill the min(id) starts-> MAP
+    Playing,        // playing the game                 -> INPUT
     Ending,         // finishing                        -> FIN
 };
 
-using PlayersHMap = std::unordered_map<byte, Player>;
-using PlayersStates = std::unordered_map<byte, GameState>;
+// everything known about another player, indexed by its player number
+struct Enemy {
+    Player          player;
+    // simulated from its inputs, the snapshots are only drawn until that works
+    Rollback        rollback;
+    JitterBuffer    snapshots;
+    GameState       state   = Initializing;
+    bool            greeted = false;    // its Hello arrived and the player is set up
+};
+using Enemies = PeerTable<Enemy>;
 
 constexpr uint PORT = 2113;
 
@@ -35,24 +53,91 @@ constexpr uint PORT = 2113;
 constexpr double TICK_RATE      = 32;
 constexpr double TICK_MSEC_DUR  = 1'000 / TICK_RATE;
 
+// simulation rate, physics constants are tuned per step at the old 240 fps cap
+constexpr double SIM_RATE       = 240;
+constexpr double SIM_STEP_SEC   = 1 / SIM_RATE;
+// steps simulated at most per frame, a stalled frame won't spiral
+constexpr int    MAX_SIM_STEPS  = 16;
+
+// the others simulate us from our inputs, a Coord this often (sec) keeps
+// the jitter buffer going for the ones that can't, and the Sync sent with
+// it puts theirs back on track whatever inputs they lost
+constexpr double COORD_HEARTBEAT = 1.0;
+
+// the map is handed to the bot's flow field worker at most this often
+// (steps), it changes with every tile streamed in, the build never blocks
+// the simulation
+constexpr u64    FLOW_REBUILD   = 60;
+
+// tiles around the START one that have to be streamed in before playing
+constexpr int    START_RADIUS   = 2;
+
+// enemies are drawn this far behind the packets received (sec), --render-delay=<msec>
+static double RENDER_DELAY      = 0.1;
+
 static byte PLAYER_NUM;     // this player's number (based on id)
 static byte N_PLAYERS;     // how many players should connect
 static uint SEED = 0;
 static byte SMALLEST_PLAYER_NUM;
-static bool STARTED_LISTENING = false;
+static bool STARTED_SERVING = false;
+static uint MAP_PACKED_SIZE = 0;   // size of the compressed map sent to others
+static std::vector<byte> MAP_PACKED; // used only when the map file can't be mapped
+static c_str MAP_PATH = nullptr;   // optional map file to edit
+static map_cache::Hash MAP_HASH;   // hash of the map advertised by its owner
+static bool MAP_CACHE_CHECKED = false;
+static bool MAP_FROM_CACHE = false; // the map was loaded without downloading it
+static map_stream::Decoder MAP_STREAM; // tiles of the map being downloaded
+// no UNKNOWN cells left, everyone steps on the same map from here on
+static bool MAP_COMPLETE = true;
 
 static u64 PLAY_CLOCK;
 
+// no window, the player is driven by a bot (--headless)
+static bool HEADLESS = false;
+static u64  SIM_TICKS = 0;
+
 // ------------- global variables --------------
 
 static Player player;
-static PlayersHMap enemies;
+static Enemies enemies;
 static Map map;
+static Bot bot;
+// the way to FINISH for the bot
+static FlowField flow_field;
+// every player where the last step left it, by player number
+static SpatialHash players_grid;
+// every player's strokes, the map is drawn together
+static StrokeLog stroke_log;
 
 static GameState        game_state;
-static PlayersStates    enemyies_states;
+
+// the last Coord sent, what the others see of us
+static Snapshot         last_sent;
+static bool             has_sent = false;
+
+// draws our stroke and sends it to the others
+void draw_stroke(Stroke stroke) {
+    stroke.lamport      = stroke_log.tick();
+    stroke.player_num   = PLAYER_NUM;
+    stroke_log.add(stroke, map);
+
+    networking::Packet pkt = {
+        .opcode     = networking::Opcode::Stroke,
+        .player_num = PLAYER_NUM,
+        .seq        = 0,
+    };
+    pkt.payload.stroke = {
+        .lamport    = stroke.lamport,
+        .x          = u16(stroke.x),
+        .y          = u16(stroke.y),
+        .cell       = stroke.cell,
+        .size       = byte(stroke.size),
+    };
+    networking::broadcast(pkt);
+}
 
 void poll_events(SDL_Event &event) {
+    std::vector<Stroke> drawn;
     while (SDL_PollEvent(&event) != 0) {
         if (event.type == SDL_QUIT) {
             game_state = GameState::Ending;
@@ -61,35 +146,62 @@ void poll_events(SDL_Event &event) {
             player.handle_event(event);
         }
         else if (game_state == Drawing) {
-            map.handle_event(event);
+            drawn.clear();
+            map.handle_event(event, drawn);
+            for (const auto &stroke: drawn) draw_stroke(stroke);
         } 
         if (event.type == SDL_KEYDOWN 
             && event.key.keysym.sym == SDLK_SPACE) {
-            if (game_state == Drawing) game_state = Connecting;
+            if (game_state == Drawing) {
+                if (MAP_PATH) map.save(MAP_PATH);
+                game_state = Connecting;
+            }
             LOG_DBG("Game state {}...", game_state);
         }
     }
 }
 
 bool is_every_enemy(GameState expected) {
-    if (enemyies_states.size() < N_PLAYERS) return false;
-    for (auto& [_, state]: enemyies_states) {
-        if (state == expected) return true;
+    if (enemies.size() < N_PLAYERS) return false;
+    for (auto [_, enemy]: enemies) {
+        if (enemy.state == expected) return true;
     }
     return false;
 }
 
-void start_tcp_listening() {
-    LOG_DBG("Started listening on TCP");
-    networking::set_tcp_buffer(map.data.data(), Map::SIZE);
-    networking::listen_to_players();
+void start_map_serving() {
+    LOG_DBG("Started serving the map");
+    MAP_HASH = map_cache::hash_map(map);
+
+    // serve the packed cells straight from the cached map file
+    std::span<const byte> packed;
+    if (map_cache::store(MAP_HASH, map) && map_cache::load(MAP_HASH, map)) {
+        packed = map.packed();
+    } else {
+        MAP_PACKED = map_stream::encode(map);
+        packed = MAP_PACKED;
+    }
+    MAP_PACKED_SIZE = packed.size();
+    LOG_DBG("Map compressed from {} to {} bytes", Map::SIZE, MAP_PACKED_SIZE);
+    networking::set_map_source(packed.data(), packed.size());
+    networking::serve_map();
 }
 
-void start_tcp_reading(byte player_num, const uint byte_count) {
-    networking::connect_to_player(player_num, byte_count);
+void start_map_download(byte player_num, const uint byte_count) {
+    // solid until its tile arrives
+    map.fill(CellType::UNKNOWN);
+    MAP_COMPLETE = false;
+    MAP_STREAM.start(byte_count);
+    networking::request_map(player_num, byte_count);
     game_state = Streaming;
 }
 
+// monotonic clock (sec), used for packet receive times
+double clock_sec() {
+    static const double perf_freq = SDL_GetPerformanceFrequency();
+    return SDL_GetPerformanceCounter() / perf_freq;
+}
+
 void change_game_state_up(GameState& prev, GameState new_state) {
     if (new_state > prev) {
         prev = new_state;
@@ -98,10 +210,7 @@ void change_game_state_up(GameState& prev, GameState new_state) {
 }
 
 void change_enemy_state(byte enemy, GameState new_state) {
-    if (!enemyies_states.contains(enemy)) {
-        enemyies_states.emplace(enemy, new_state);
-    }
-    change_game_state_up(enemyies_states.at(enemy), new_state);
+    change_game_state_up(enemies[enemy].state, new_state);
 }
 
 
@@ -110,14 +219,16 @@ void setup_playing_state() {
         return;
     }
     const auto& [x, y] = map.start_point;
-    for (auto &[_, enemy]: enemies) {
-        enemy.set_new_data(x, y, 0, 0);
+    for (auto [_, enemy]: enemies) {
+        enemy.player.set_new_data(x, y, 0, 0);
+        enemy.snapshots.clear();
     }
     player.set_new_data(x, y, 0, 0);
 }
 
 void poll_packets() {
     auto packets = networking::poll();
+    const double now = clock_sec();
 
     // [TODO]: Refactor
     for (const auto &pkt: packets) {
@@ -126,16 +237,44 @@ void poll_packets() {
         if (pkt.opcode == networking::Opcode::Coord) {
             auto [x, y]     = pkt.payload.move.coord;
             auto [dx, dy]   = pkt.payload.move.d_vel;
-            auto& enemy = enemies[pkt.player_num];
-            enemy.set_new_data(x, y, dx, dy);
-            enemy.should_predict = false;
+            // rendered from the jitter buffer, velocity is per simulation step
+            enemies[pkt.player_num].snapshots.push(Snapshot {
+                .seq    = pkt.seq,
+                .time   = now,
+                .x      = float(x),
+                .y      = float(y),
+                .vel_x  = float(dx * SIM_RATE),
+                .vel_y  = float(dy * SIM_RATE),
+            });
 
             change_game_state_up(game_state, Playing);
         } 
+        // what a player did in one of its ticks, rolled back to if mispredicted
+        else if (pkt.opcode == networking::Opcode::Input) {
+            change_game_state_up(game_state, Playing);
+            // simulated against our UNKNOWN cells it would hit walls that aren't there
+            if (!MAP_COMPLETE) continue;
+            const auto &in = pkt.payload.input;
+            enemies[pkt.player_num].rollback.on_input(in.tick, Input {
+                .direction  = Direction(in.direction),
+                .jump       = in.jump,
+            }, SIM_TICKS);
+        }
+        // the player's own state after its tick, the rollback starts or corrects from it
+        else if (pkt.opcode == networking::Opcode::Sync) {
+            change_game_state_up(game_state, Playing);
+            if (!MAP_COMPLETE) continue;
+            const auto &sync = pkt.payload.sync;
+            enemies[pkt.player_num].rollback.on_state(sync.tick, Player::State {
+                .pos        = {int(sync.x), int(sync.y)},
+                .vel        = Vector2D(Real::from_raw(sync.vel_x), Real::from_raw(sync.vel_y)),
+                .has_jumped = sync.has_jumped,
+            }, SIM_TICKS);
+        }
         // adding a new player
         else if (game_state != Drawing && pkt.opcode == networking::Opcode::Hello) {
             // already exists
-            if (enemies.contains(pkt.player_num)) continue;
+            if (enemies.contains(pkt.player_num) && enemies.at(pkt.player_num).greeted) continue;
 
             change_enemy_state(pkt.player_num, GameState::Connecting);
             if (pkt.player_num < SMALLEST_PLAYER_NUM) SMALLEST_PLAYER_NUM = pkt.player_num;
@@ -146,22 +285,22 @@ void poll_packets() {
                 LOG("All players are in the Connecting state");
                 change_game_state_up(game_state, Streaming);
 
-                // the map's owner starts accepting on the TCP connection wayy before others
-                if (PLAYER_NUM == SMALLEST_PLAYER_NUM && STARTED_LISTENING == false) {
-                    start_tcp_listening();
-                    STARTED_LISTENING = true;
+                // the map's owner starts serving the map wayy before others ask for it
+                if (PLAYER_NUM == SMALLEST_PLAYER_NUM && STARTED_SERVING == false) {
+                    start_map_serving();
+                    STARTED_SERVING = true;
                 }
             }
 
-            Player enemy;
-            enemy.pos = {Map::WIDTH / 2, Map::HEIGHT / 2};
-            enemy.colour = {
+            auto& enemy = enemies.at(pkt.player_num);
+            enemy.greeted = true;
+            enemy.player.set_new_data(Map::WIDTH / 2, Map::HEIGHT / 2, 0, 0);
+            enemy.player.colour = {
                 .r = byte(155 + SEED % 100),
                 .g = byte((SEED / 256) % 256),
                 .b = byte((SEED / (256 * 256)) % 256),
                 .a = byte(255)
             };
-            enemies.emplace(pkt.player_num, enemy);
         }
         // the lowest id sent ACK
         else if (pkt.opcode == networking::Opcode::Ack) {
@@ -173,12 +312,66 @@ void poll_packets() {
             if (pkt.player_num <= SMALLEST_PLAYER_NUM){
                 SMALLEST_PLAYER_NUM = pkt.player_num;
                 LOG("Connecting to sender... {}", pkt.player_num);
-                start_tcp_reading(SMALLEST_PLAYER_NUM, pkt.payload.map_buff_size);
+                const auto &size = pkt.payload.map_buff_size;
+                if (size.raw != Map::SIZE) {
+                    LOG_ERR("Map size mismatch: {} received, {} expected", size.raw, Map::SIZE);
+                    continue;
+                }
+                if (!MAP_CACHE_CHECKED) {
+                    MAP_CACHE_CHECKED = true;
+                    memcpy(MAP_HASH.data(), pkt.payload.map_hash, MAP_HASH.size());
+                    // everyone's strokes drew the same map here already
+                    if (map_cache::hash_map(map) == MAP_HASH) {
+                        LOG("The drawn map is in sync with the owner's");
+                        MAP_FROM_CACHE = true;
+                        change_game_state_up(game_state, Ready);
+                        setup_playing_state();
+                        continue;
+                    }
+                    // skip the stream entirely if we've played this map before
+                    if (map_cache::load(MAP_HASH, map)) {
+                        LOG("Loaded the map from the cache");
+                        MAP_FROM_CACHE = true;
+                        map.update();
+                        change_game_state_up(game_state, Ready);
+                        setup_playing_state();
+                        continue;
+                    }
+                }
+                if (MAP_FROM_CACHE) continue;
+                start_map_download(SMALLEST_PLAYER_NUM, size.packed);
             }
         } 
-        // finished TCP operations on some socket
-        if (pkt.opcode == networking::Opcode::Done_TCP) {
-            // copy the buffer data to the map
+        // another player drew, until the map is streamed it's drawn here too
+        else if (pkt.opcode == networking::Opcode::Stroke) {
+            if (game_state >= Streaming) continue;
+            const auto &s = pkt.payload.stroke;
+            stroke_log.add(Stroke {
+                .lamport    = s.lamport,
+                .player_num = pkt.player_num,
+                .x          = s.x,
+                .y          = s.y,
+                .cell       = CellType(s.cell),
+                .size       = s.size,
+            }, map);
+        }
+        // a piece of the map arrived
+        else if (pkt.opcode == networking::Opcode::Map_Part) {
+            const auto &part = pkt.payload.map_part;
+            if (!MAP_STREAM.on_bytes(networking::map_buffer().data(), part.offset, part.size, map)) {
+                LOG_ERR("Received a malformed map stream");
+                continue;
+            }
+            MAP_COMPLETE = MAP_STREAM.done();
+            // play once the area around START is in, the rest streams in meanwhile
+            if (game_state == Streaming && MAP_STREAM.is_resident_around_start(START_RADIUS)) {
+                LOG("The area around START arrived, starting");
+                change_game_state_up(game_state, Ready);
+                setup_playing_state();
+            }
+        }
+        // a map transfer finished, or the player can play already
+        if (pkt.opcode == networking::Opcode::Done_Map) {
             change_enemy_state(pkt.player_num, GameState::Ready);
 
             // if we are the owner of a map
@@ -191,12 +384,23 @@ void poll_packets() {
                     setup_playing_state();
                 }
             }
-            // otherwise load the map into the game
-            else if (PLAYER_NUM != SMALLEST_PLAYER_NUM) {
-                auto tcp_buff = networking::return_tcp_buffer();
-                map.update(tcp_buff);
-                change_game_state_up(game_state, Ready);
-                setup_playing_state();
+            // otherwise load the map into the game (only our own stream finishing)
+            else if (pkt.player_num == PLAYER_NUM) {
+                // the tiles were decoded as they arrived
+                if (!MAP_STREAM.done()) {
+                    LOG_ERR("The map download ended with tiles missing");
+                    continue;
+                }
+                if (map_cache::hash_map(map) == MAP_HASH) {
+                    map_cache::store(MAP_HASH, map);
+                } else {
+                    LOG_ERR("Received map does not match the advertised hash");
+                }
+                // might be playing already
+                if (game_state < Ready) {
+                    change_game_state_up(game_state, Ready);
+                    setup_playing_state();
+                }
             }
         }
     }
@@ -208,16 +412,51 @@ void render_clear(SDL_Renderer *renderer, SDL_Texture *map_texture) {
     SDL_RenderCopy(renderer, map_texture, NULL, NULL);
 }
 
+// our exact state, whoever simulates us starts or corrects from it
+void send_sync() {
+    networking::Packet pkt = {
+        .opcode     = networking::Opcode::Sync,
+        .player_num = PLAYER_NUM,
+        .seq        = 0,
+    };
+    const auto state = player.state();
+    pkt.payload.sync = {
+        .tick       = uint(SIM_TICKS),
+        .x          = state.pos.x,
+        .y          = state.pos.y,
+        .vel_x      = i32(state.vel.x.raw),
+        .vel_y      = i32(state.vel.y.raw),
+        .has_jumped = state.has_jumped,
+    };
+    networking::broadcast(pkt);
+}
+
+bool should_send_coord(double now) {
+    return !has_sent || now - last_sent.time >= COORD_HEARTBEAT;
+}
+
 void send_udp_packets() {
     networking::Packet pkt = {
         .opcode     = networking::Opcode::Coord,
         .player_num = PLAYER_NUM,
         .seq        = 0,
         .payload    = {player.pos.x, player.pos.y, 
-            player.vel.x, player.vel.y},
+            player.vel.x.to_float(), player.vel.y.to_float()},
     };
     if (game_state == Playing) {
-        networking::broadcast(pkt);
+        const double now = clock_sec();
+        if (should_send_coord(now)) {
+            networking::broadcast(pkt);
+            send_sync();
+            last_sent = Snapshot {
+                .time   = now,
+                .x      = float(player.pos.x),
+                .y      = float(player.pos.y),
+                .vel_x  = player.vel.x.to_float() * float(SIM_RATE),
+                .vel_y  = player.vel.y.to_float() * float(SIM_RATE),
+            };
+            has_sent = true;
+        }
     }
     else if (game_state == Connecting || game_state == Streaming) {
         pkt.opcode = networking::Opcode::Hello;
@@ -229,25 +468,132 @@ void send_udp_packets() {
         LOG_DBG("this: {} small: {}; SENDING ACK TO PLAYERS...", PLAYER_NUM, SMALLEST_PLAYER_NUM);
         if (PLAYER_NUM == SMALLEST_PLAYER_NUM) {
             pkt.opcode = networking::Opcode::Ack;
-            pkt.payload.map_buff_size = map.SIZE;
+            pkt.payload.map_buff_size = {
+                .packed = MAP_PACKED_SIZE,
+                .raw    = Map::SIZE,
+            };
+            memcpy(pkt.payload.map_hash, MAP_HASH.data(), MAP_HASH.size());
             networking::broadcast(pkt);
         }
     }
+    if (game_state == Ready && PLAYER_NUM != SMALLEST_PLAYER_NUM) {
+        // we can play, the owner might not know it, the map might still be streaming
+        pkt.opcode = networking::Opcode::Done_Map;
+        networking::broadcast(pkt);
+    }
+    networking::flush();
+}
+
+// our input of the tick, sent with the next datagrams
+void send_input(Input input) {
+    networking::Packet pkt = {
+        .opcode     = networking::Opcode::Input,
+        .player_num = PLAYER_NUM,
+        .seq        = 0,
+    };
+    pkt.payload.input = {
+        .tick       = uint(SIM_TICKS),
+        .direction  = byte(input.direction),
+        .jump       = input.jump,
+    };
+    networking::broadcast(pkt);
+}
+
+// advances the game by one fixed simulation step
+void simulate_step() {
+    ++SIM_TICKS;
+    if (HEADLESS && SIM_TICKS % FLOW_REBUILD == 1) flow_field.update(map);
+    const Input input = HEADLESS ? bot.drive(player, map, flow_field) : player.take_input();
+    player.step(map, input);
+    send_input(input);
+    static std::vector<Rollback*>   rollbacks;
+    static std::vector<Player*>     bodies;
+    rollbacks.clear();
+    bodies.clear();
+    for (auto [_, enemy]: enemies) {
+        rollbacks.push_back(&enemy.rollback);
+        bodies.push_back(&enemy.player);
+    }
+    advance(rollbacks, bodies, map, SIM_TICKS);
+    auto const& x = player.pos.x;
+    auto const& y = player.pos.y;
+
+    players_grid.clear();
+    players_grid.add(PLAYER_NUM, x, y);
+    for (auto [num, enemy]: enemies) {
+        players_grid.add(num, enemy.player.pos.x, enemy.player.pos.y);
+    }
+    players_grid.build();
+
+    if (map.at_bnd(x, y) == FINISH) {
+        PLAY_CLOCK = SDL_GetTicks64() - PLAY_CLOCK;
+        LOG(" --------------------------------------------- ");
+        LOG("       TIME ELAPSED (msec): {}", PLAY_CLOCK);
+        LOG(" --------------------------------------------- ");
+        change_game_state_up(game_state, Ending);
+    }
 }
 
-void display_players(SDL_Renderer *renderer) {
-    for (auto& [_, enemy]: enemies) {
-        if (enemy.should_predict) enemy.update_position(map);
-        else enemy.should_predict = true;
-        enemy.render(renderer);
+// alpha - how far between the previous and the current step to draw
+void display_players(SDL_Renderer *renderer, float alpha) {
+    const double render_time = clock_sec() - RENDER_DELAY;
+    // the ones overlapping us are outlined, we stay visible under them
+    static std::array<bool, Enemies::SLOTS> overlaps;
+    overlaps.fill(false);
+    const int reach = std::max(player.SIZE.WIDTH, player.SIZE.HEIGHT);
+    players_grid.query(player.pos.x, player.pos.y, reach, [](const SpatialHash::Entry &e) {
+        overlaps[e.id] = e.id != PLAYER_NUM
+            && std::abs(e.x - player.pos.x) < player.SIZE.WIDTH
+            && std::abs(e.y - player.pos.y) < player.SIZE.HEIGHT;
+    });
+    for (auto [num, enemy]: enemies) {
+        auto& body = enemy.player;
+        float x, y;
+        if (!enemy.rollback.active() && enemy.snapshots.sample(render_time, x, y)) {
+            body.pos = {int(lroundf(x)), int(lroundf(y))};
+            body.prev_pos = body.pos;
+        }
+        body.render(renderer, alpha, overlaps[num]);
     }
-    player.render(renderer);
+    player.render(renderer, alpha);
 }
 
 
+// prints the simulation and network throughput once a second
+void report_stats(u64 now) {
+    static u64 prev_time    = now;
+    static u64 prev_ticks   = 0;
+    static networking::Stats prev_net = {};
+    if (now - prev_time < 1'000) return;
+
+    const double secs = (now - prev_time) / 1'000.0;
+    const auto net = networking::stats();
+    LOG("ticks/s: {:.1f}  packets/s in: {:.1f} out: {:.1f}  syscalls/s recv: {:.1f} send: {:.1f}",
+        (SIM_TICKS - prev_ticks) / secs,
+        (net.packets_received - prev_net.packets_received) / secs,
+        (net.packets_sent - prev_net.packets_sent) / secs,
+        (net.recv_calls - prev_net.recv_calls) / secs,
+        (net.send_calls - prev_net.send_calls) / secs);
+    prev_time   = now;
+    prev_ticks  = SIM_TICKS;
+    prev_net    = net;
+}
+
 int main(int argc, char* argv[]) {
+    // options can go anywhere, the rest are positional arguments
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) HEADLESS = true;
+        else if (strncmp(argv[i], "--render-delay=", 15) == 0) {
+            RENDER_DELAY = atoi(argv[i] + 15) / 1'000.0;
+        }
+        else args.push_back(argv[i]);
+    }
+    argc = args.size();
+    argv = args.data();
+
     if (argc < 5) {
-        LOG("Usage: {} <device> <essid> <player_id 1-254> <player_count 0-255>", argv[0]);
+        LOG("Usage: {} <device> <essid> <player_id 1-254> <player_count 0-255> [map file] [--headless] [--render-delay=<msec>]", argv[0]);
         return EXIT_FAILURE;
     }
     game_state = Initializing;
@@ -259,6 +605,7 @@ int main(int argc, char* argv[]) {
     PLAYER_NUM  = atoi(argv[3]);
     SMALLEST_PLAYER_NUM = PLAYER_NUM;
     N_PLAYERS   = (byte)atoi(argv[4]);
+    if (argc > 5) MAP_PATH = argv[5];
 
     auto cfg = networking::NetConfig {
         .device     = argv[1],
@@ -276,49 +623,64 @@ int main(int argc, char* argv[]) {
     }
 
     // -------------------------- sdl  init ---------------------------
-    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
-    SDL_Window* window = SDL_CreateWindow(
-        argv[0], 
-        SDL_WINDOWPOS_UNDEFINED, 
-        SDL_WINDOWPOS_UNDEFINED,
-        Map::WIDTH, Map::HEIGHT, SDL_WINDOW_SHOWN
-    );
-    SDL_Renderer* renderer = SDL_CreateRenderer(
-        window, 
-        -1, 
-        SDL_RENDERER_ACCELERATED
-    );
-    SDL_Texture* map_texture = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_TARGET,
-        Map::WIDTH, Map::HEIGHT 
-    );
+    SDL_Window*     window      = nullptr;
+    SDL_Renderer*   renderer    = nullptr;
+    SDL_Texture*    map_texture = nullptr;
+    if (HEADLESS) {
+        SDL_Init(SDL_INIT_TIMER);
+    } else {
+        SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
+        window = SDL_CreateWindow(
+            argv[0], 
+            SDL_WINDOWPOS_UNDEFINED, 
+            SDL_WINDOWPOS_UNDEFINED,
+            Map::WIDTH, Map::HEIGHT, SDL_WINDOW_SHOWN
+        );
+        renderer = SDL_CreateRenderer(
+            window, 
+            -1, 
+            SDL_RENDERER_ACCELERATED
+        );
+        map_texture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET,
+            Map::WIDTH, Map::HEIGHT 
+        );
+    }
     map._texture = map_texture;
 	map._renderer = renderer;
+    if (MAP_PATH && map.load(MAP_PATH)) {
+        map.update();
+    }
+    stroke_log.start(map);
 
-    defer {SDL_DestroyTexture(map_texture);};
-    defer {SDL_DestroyRenderer(renderer);};
-    defer {SDL_DestroyWindow(window);};
+    defer {if (map_texture) SDL_DestroyTexture(map_texture);};
+    defer {if (renderer)    SDL_DestroyRenderer(renderer);};
+    defer {if (window)      SDL_DestroyWindow(window);};
     defer {SDL_Quit();};
 
-    player.pos = {Map::WIDTH / 2, Map::HEIGHT / 2};
+    player.set_new_data(Map::WIDTH / 2, Map::HEIGHT / 2, 0, 0);
 
-    // Clear the texture to a specific color
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-    // Reset the target to the default rendering target (the window)
-    SDL_SetRenderTarget(renderer, NULL);
+    if (renderer) {
+        // Clear the texture to a specific color
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        // Reset the target to the default rendering target (the window)
+        SDL_SetRenderTarget(renderer, NULL);
+    }
     player.colour = {255, 255, 255, 255};
     player.player_num = PLAYER_NUM;
 
 
     srand(time(NULL));
     SEED = rand();
+    bot.seed = SEED | 1;
 
     // -------------------------- main loop ---------------------------
     SDL_Event event;
-    game_state = Drawing;
+    // nobody draws in headless mode, the map comes from the file or the owner
+    game_state = HEADLESS ? Connecting : Drawing;
 
     u64 prev_tick = SDL_GetTicks64();
     u64 curr_tick = prev_tick;
@@ -329,28 +691,35 @@ int main(int argc, char* argv[]) {
     u64 prev_frame = SDL_GetTicks64();
     u64 delta_frame;
 
+    // fixed step simulation, decoupled from the frame rate
+    const double perf_freq = SDL_GetPerformanceFrequency();
+    u64 prev_count = SDL_GetPerformanceCounter();
+    double sim_accumulator = 0;
+
     // [TODO] Refactor
     while (game_state != GameState::Ending) {
-        poll_events(event);
+        if (!HEADLESS) poll_events(event);
         poll_packets();
 
-        render_clear(renderer, map_texture);
-        if (game_state == Playing) {
-            player.update_position(map);
-            auto const& x = player.pos.x;
-            auto const& y = player.pos.y;
-
-            if (map.at_bnd(x, y) == FINISH) {
-                PLAY_CLOCK = SDL_GetTicks64() - PLAY_CLOCK;
-                LOG(" --------------------------------------------- ");
-                LOG("       TIME ELAPSED (msec): {}", PLAY_CLOCK);
-                LOG(" --------------------------------------------- ");
-                change_game_state_up(game_state, Ending);
-            }
+        const u64 curr_count = SDL_GetPerformanceCounter();
+        sim_accumulator += (curr_count - prev_count) / perf_freq;
+        sim_accumulator  = std::min(sim_accumulator, MAX_SIM_STEPS * SIM_STEP_SEC);
+        prev_count = curr_count;
 
-            display_players(renderer);
+        while (sim_accumulator >= SIM_STEP_SEC) {
+            sim_accumulator -= SIM_STEP_SEC;
+            if (game_state == Playing) simulate_step();
+        }
+
+        if (HEADLESS) {
+            report_stats(SDL_GetTicks64());
+        } else {
+            render_clear(renderer, map_texture);
+            if (game_state == Playing) {
+                display_players(renderer, float(sim_accumulator / SIM_STEP_SEC));
+            }
+            SDL_RenderPresent(renderer);
         }
-        SDL_RenderPresent(renderer);
 
         // tick synchro
         curr_tick = SDL_GetTicks64();
@@ -0,0 +1,66 @@
+#include "map_cache.hpp"
+#include "sha256.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace map_cache {
+
+static fs::path cache_dir() {
+    if (c_str xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return fs::path(xdg) / "adhoctopia";
+    }
+    if (c_str home = getenv("HOME"); home && *home) {
+        return fs::path(home) / ".cache" / "adhoctopia";
+    }
+    return fs::path(".cache") / "adhoctopia";
+}
+
+static fs::path path_for(const Hash &hash) {
+    return cache_dir() / (sha256::to_hex(hash.data(), hash.size()) + ".map");
+}
+
+Hash hash_map(const Map &map) {
+    auto digest = sha256::hash(map.data.data(), Map::SIZE);
+    Hash hash;
+    memcpy(hash.data(), digest.data(), HASH_SIZE);
+    return hash;
+}
+
+bool load(const Hash &hash, Map &map) {
+    const auto path = path_for(hash);
+    if (!fs::exists(path)) {
+        LOG_DBG("Map {} is not cached", path.string());
+        return false;
+    }
+    // the map file checks its own checksum when it's opened
+    if (!map.load(path.c_str())) {
+        LOG_ERR("Cached map {} is corrupted", path.string());
+        return false;
+    }
+    LOG_DBG("Loaded map {} from the cache", path.string());
+    return true;
+}
+
+bool store(const Hash &hash, const Map &map) {
+    std::error_code err;
+    fs::create_directories(cache_dir(), err);
+    if (err) {
+        LOG_ERR("Failed to create the map cache directory: {}", err.message());
+        return false;
+    }
+    const auto path = path_for(hash);
+    if (fs::exists(path)) return true;
+
+    if (!map.save(path.c_str())) {
+        LOG_ERR("Failed to store the map {} in the cache", path.string());
+        return false;
+    }
+    LOG_DBG("Stored map {} in the cache", path.string());
+    return true;
+}
+
+};
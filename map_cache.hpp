@@ -0,0 +1,23 @@
+#ifndef ADHTP_MAP_CACHE_HDR
+#define ADHTP_MAP_CACHE_HDR
+
+#include "types.hpp"
+#include "Map.hpp"
+#include <array>
+
+/* on-disk cache of received maps, addressed by their hash  *
+ * lives in $XDG_CACHE_HOME/adhoctopia or ~/.cache/...      */
+namespace map_cache {
+
+// truncated sha256 of Map::data, advertised in the Ack packet
+static constexpr size_t HASH_SIZE = 16;
+using Hash = std::array<byte, HASH_SIZE>;
+
+Hash hash_map(const Map &map);
+// maps a cached map file into map.data, fails if missing or corrupted
+bool load(const Hash &hash, Map &map);
+// saves the map file under its hash unless it's already cached
+bool store(const Hash &hash, const Map &map);
+
+};
+#endif //ADHTP_MAP_CACHE_HDR
@@ -0,0 +1,145 @@
+#include "map_file.hpp"
+#include "sha256.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace map_file {
+
+// the packed stream is served straight from the file, it's covered too
+static sha256::Digest checksum(const byte *cells, size_t cells_size, std::span<const byte> packed) {
+    std::array<byte, 2 * sizeof(sha256::Digest)> digests;
+    const auto cells_digest     = sha256::hash(cells, cells_size);
+    const auto packed_digest    = sha256::hash(packed.data(), packed.size());
+    memcpy(digests.data(), cells_digest.data(), cells_digest.size());
+    memcpy(digests.data() + cells_digest.size(), packed_digest.data(), packed_digest.size());
+    return sha256::hash(digests.data(), digests.size());
+}
+
+Mapping::Mapping(Mapping &&other) : _addr(other._addr), _size(other._size) {
+    other._addr = nullptr;
+    other._size = 0;
+}
+
+Mapping &Mapping::operator=(Mapping &&other) {
+    if (this != &other) {
+        close();
+        _addr = other._addr;
+        _size = other._size;
+        other._addr = nullptr;
+        other._size = 0;
+    }
+    return *this;
+}
+
+Mapping::~Mapping() {
+    close();
+}
+
+void Mapping::close() {
+    if (_addr) munmap(_addr, _size);
+    _addr = nullptr;
+    _size = 0;
+}
+
+const Header &Mapping::header() const {
+    return *(const Header*)_addr;
+}
+
+byte *Mapping::cells() const {
+    return _addr + header().cells_offset;
+}
+
+std::span<const byte> Mapping::packed() const {
+    return {_addr + header().packed_offset, header().packed_size};
+}
+
+bool Mapping::open(c_str path, uint16_t width, uint16_t height) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd == -1) {
+        LOG_DBG("Failed to open the map file {}", path);
+        return false;
+    }
+    defer {::close(fd);};
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(Header)) {
+        LOG_ERR("Map file {} is too small", path);
+        return false;
+    }
+    // private writable pages, so drawing on a loaded map never touches the file
+    void *addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        LOG_ERR("Failed to mmap the map file {}", path);
+        perror("What");
+        return false;
+    }
+    _addr = (byte*)addr;
+    _size = st.st_size;
+
+    const auto &hdr = header();
+    const size_t cells_size = size_t(width) * height;
+    if (memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) != 0
+        || hdr.version != VERSION || hdr.header_size != sizeof(Header)) {
+        LOG_ERR("{} is not a supported map file", path);
+        close();
+        return false;
+    }
+    if (hdr.width != width || hdr.height != height) {
+        LOG_ERR("Map file {} is {}x{}, expected {}x{}", path, hdr.width, hdr.height, width, height);
+        close();
+        return false;
+    }
+    if (size_t(hdr.cells_offset) + cells_size > _size
+        || size_t(hdr.packed_offset) + hdr.packed_size > _size) {
+        LOG_ERR("Map file {} is truncated", path);
+        close();
+        return false;
+    }
+    auto digest = checksum(cells(), cells_size, packed());
+    if (memcmp(digest.data(), hdr.checksum, sizeof(hdr.checksum)) != 0) {
+        LOG_ERR("Map file {} is corrupted", path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool write(c_str path, Header header, const byte *cells, const std::vector<byte> &packed) {
+    const size_t cells_size = size_t(header.width) * header.height;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version       = VERSION;
+    header.header_size   = sizeof(Header);
+    header.cells_offset  = sizeof(Header);
+    header.packed_offset = sizeof(Header) + cells_size;
+    header.packed_size   = packed.size();
+    auto digest = checksum(cells, cells_size, packed);
+    memcpy(header.checksum, digest.data(), sizeof(header.checksum));
+
+    // write to a temporary file first, a mapped old version stays intact
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        LOG_ERR("Failed to create the map file {}", tmp_path);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(cells, 1, cells_size, file) == cells_size
+           && fwrite(packed.data(), 1, packed.size(), file) == packed.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path) != 0) {
+        LOG_ERR("Failed to write the map file {}", path);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+};
@@ -0,0 +1,68 @@
+#ifndef ADHTP_MAP_FILE_HDR
+#define ADHTP_MAP_FILE_HDR
+
+#include "types.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/* on-disk map format, stored in host byte order:           *
+ * [Header][cells: width * height bytes][map stream]        *
+ * the cells are used in place through mmap and the packed  *
+ * stream is what gets sent to the other players, see       *
+ * map_stream.hpp for its layout                            */
+namespace map_file {
+
+static constexpr char       MAGIC[4]    = {'A', 'H', 'T', 'M'};
+static constexpr uint16_t   VERSION     = 3;
+
+enum Flags: byte {
+    HAS_START   = 0x01,
+    HAS_FINISH  = 0x02,
+};
+
+struct Header {
+    char        magic[4];
+    uint16_t    version;
+    uint16_t    header_size;
+    uint16_t    width;
+    uint16_t    height;
+    int32_t     start[2];
+    int32_t     finish[2];
+    byte        flags;
+    byte        __padding__[3];
+    uint32_t    cells_offset;
+    uint32_t    packed_offset;
+    uint32_t    packed_size;
+    byte        checksum[16];   // truncated sha256 of the cells' and the stream's sha256
+    byte        __reserved__[4];
+};
+static_assert(sizeof(Header) == 64, "map file header layout changed");
+
+// a map file mapped into memory, private copy-on-write pages
+struct Mapping {
+    Mapping() = default;
+    Mapping(Mapping &&other);
+    Mapping &operator=(Mapping &&other);
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+    ~Mapping();
+
+    bool is_open() const { return _addr != nullptr; }
+    const Header &header() const;
+    byte *cells() const;
+    std::span<const byte> packed() const;
+
+    // maps the file and validates the header and the checksum
+    bool open(c_str path, uint16_t width, uint16_t height);
+    void close();
+private:
+    byte    *_addr = nullptr;
+    size_t  _size  = 0;
+};
+
+// fills in the offsets and the checksum of the header and writes the file
+bool write(c_str path, Header header, const byte *cells, const std::vector<byte> &packed);
+
+};
+#endif //ADHTP_MAP_FILE_HDR
@@ -0,0 +1,191 @@
+#include "map_stream.hpp"
+#include "rle.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+
+namespace map_stream {
+
+// start, finish and the flags
+static constexpr size_t FIXED_HEADER = 4 * 2 + 1;
+
+struct TileRect {
+    int x0, y0, w, h;
+};
+
+static TileRect tile_rect(int tile) {
+    const int x0 = tile % TILES_X * TILE;
+    const int y0 = tile / TILES_X * TILE;
+    return {x0, y0, std::min(TILE, Map::WIDTH - x0), std::min(TILE, Map::HEIGHT - y0)};
+}
+
+static int tile_of(int x, int y, int &tile_x, int &tile_y) {
+    tile_x = std::clamp(x, 0, Map::WIDTH - 1) / TILE;
+    tile_y = std::clamp(y, 0, Map::HEIGHT - 1) / TILE;
+    return tile_x + tile_y * TILES_X;
+}
+
+std::array<uint16_t, TILE_COUNT> tile_order(int x, int y) {
+    int sx, sy;
+    tile_of(x, y, sx, sy);
+    auto ring = [&](int tile) {
+        return std::max(std::abs(tile % TILES_X - sx), std::abs(tile / TILES_X - sy));
+    };
+    std::array<uint16_t, TILE_COUNT> order;
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) {
+        return ring(a) < ring(b);
+    });
+    return order;
+}
+
+static void put_u16(std::vector<byte> &out, int value) {
+    out.push_back(byte(value >> 8));
+    out.push_back(byte(value));
+}
+
+static void put_varint(std::vector<byte> &out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(byte(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(byte(value));
+}
+
+std::vector<byte> encode(const Map &map) {
+    const auto [sx, sy] = map.start_point;
+    const auto [fx, fy] = map.finish_point;
+    const int start_x = map.start_initialised ? sx : 0;
+    const int start_y = map.start_initialised ? sy : 0;
+
+    std::vector<byte> out;
+    put_u16(out, start_x);
+    put_u16(out, start_y);
+    put_u16(out, map.finish_initialised ? fx : 0);
+    put_u16(out, map.finish_initialised ? fy : 0);
+    out.push_back(byte((map.start_initialised  ? map_file::HAS_START  : 0)
+                     | (map.finish_initialised ? map_file::HAS_FINISH : 0)));
+
+    const auto order = tile_order(start_x, start_y);
+    std::vector<std::vector<byte>> tiles(TILE_COUNT);
+    byte cells[TILE * TILE];
+    for (int pos = 0; pos < TILE_COUNT; ++pos) {
+        const auto rect = tile_rect(order[pos]);
+        for (int y = 0; y < rect.h; ++y) {
+            memcpy(cells + y * rect.w, map.data.data() + rect.x0 + (rect.y0 + y) * Map::WIDTH, rect.w);
+        }
+        tiles[pos] = rle::encode(cells, rect.w * rect.h);
+        put_varint(out, tiles[pos].size());
+    }
+    for (const auto &tile: tiles) {
+        out.insert(out.end(), tile.begin(), tile.end());
+    }
+    return out;
+}
+
+void Decoder::start(size_t size) {
+    _present.assign(size, false);
+    _prefix         = 0;
+    _has_header     = false;
+    _resident.fill(false);
+    _resident_count = 0;
+}
+
+bool Decoder::is_resident(int tile_x, int tile_y) const {
+    if (tile_x < 0 || tile_x >= TILES_X || tile_y < 0 || tile_y >= TILES_Y) return true;
+    return _resident[tile_x + tile_y * TILES_X];
+}
+
+bool Decoder::is_resident_around_start(int radius) const {
+    if (!_has_header) return false;
+    for (int y = _start_y - radius; y <= _start_y + radius; ++y) {
+        for (int x = _start_x - radius; x <= _start_x + radius; ++x) {
+            if (!is_resident(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+int Decoder::_parse_header(const byte *stream, Map &map) {
+    if (_prefix < FIXED_HEADER) return 0;
+    auto u16_at = [&](size_t i) { return int(stream[i]) << 8 | stream[i + 1]; };
+    size_t in = FIXED_HEADER;
+    std::array<size_t, TILE_COUNT> sizes;
+    for (auto &size: sizes) {
+        size = 0;
+        for (uint shift = 0;; shift += 7) {
+            if (in >= _prefix) return 0;
+            if (shift > 28) return -1;
+            const byte b = stream[in++];
+            size |= size_t(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) break;
+        }
+    }
+    _offsets[0] = in;
+    for (int pos = 0; pos < TILE_COUNT; ++pos) {
+        _offsets[pos + 1] = _offsets[pos] + sizes[pos];
+    }
+    if (_offsets[TILE_COUNT] != _present.size()) {
+        LOG_ERR("Map stream: tiles take {} bytes, the stream is {}",
+                _offsets[TILE_COUNT], _present.size());
+        return -1;
+    }
+
+    const byte flags = stream[8];
+    map.start_initialised   = flags & map_file::HAS_START;
+    map.finish_initialised  = flags & map_file::HAS_FINISH;
+    map.start_point         = {u16_at(0), u16_at(2)};
+    map.finish_point        = {u16_at(4), u16_at(6)};
+    _order = tile_order(u16_at(0), u16_at(2));
+    tile_of(u16_at(0), u16_at(2), _start_x, _start_y);
+    _has_header = true;
+    return 1;
+}
+
+bool Decoder::_decode_tile(const byte *stream, int pos, Map &map) {
+    const int tile = _order[pos];
+    const auto rect = tile_rect(tile);
+    byte cells[TILE * TILE];
+    if (!rle::decode(stream + _offsets[pos], _offsets[pos + 1] - _offsets[pos],
+                     cells, rect.w * rect.h)) {
+        LOG_ERR("Map stream: tile {} is corrupted", tile);
+        return false;
+    }
+    for (int y = 0; y < rect.h; ++y) {
+        memcpy(map.data.data() + rect.x0 + (rect.y0 + y) * Map::WIDTH, cells + y * rect.w, rect.w);
+    }
+    map.update(rect.x0, rect.y0, rect.x0 + rect.w - 1, rect.y0 + rect.h - 1);
+    _resident[tile] = true;
+    ++_resident_count;
+    return true;
+}
+
+bool Decoder::on_bytes(const byte *stream, size_t offset, size_t size, Map &map) {
+    if (offset + size > _present.size()) return false;
+    std::fill(_present.begin() + offset, _present.begin() + offset + size, true);
+    while (_prefix < _present.size() && _present[_prefix]) ++_prefix;
+
+    // tiles of these bytes, all of them once the header is in
+    int first = 0, last = TILE_COUNT;
+    if (!_has_header) {
+        const int parsed = _parse_header(stream, map);
+        if (parsed <= 0) return parsed == 0;
+    } else {
+        first = std::upper_bound(_offsets.begin(), _offsets.end(), offset) - _offsets.begin() - 1;
+        last  = std::lower_bound(_offsets.begin(), _offsets.end(), offset + size) - _offsets.begin();
+        first = std::max(first, 0);
+        last  = std::min(last, TILE_COUNT);
+    }
+    for (int pos = first; pos < last; ++pos) {
+        if (_resident[_order[pos]]) continue;
+        const auto begin = _present.begin() + _offsets[pos];
+        const auto end   = _present.begin() + _offsets[pos + 1];
+        if (std::find(begin, end, false) != end) continue;
+        if (!_decode_tile(stream, pos, map)) return false;
+    }
+    return true;
+}
+
+};
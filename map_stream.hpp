@@ -0,0 +1,61 @@
+#ifndef ADHTP_MAP_STREAM_HDR
+#define ADHTP_MAP_STREAM_HDR
+
+#include "types.hpp"
+#include "Map.hpp"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/* the map as it is sent to the other players:              *
+ * [start x, y][finish x, y][flags][packed size per tile]   *
+ * followed by the tiles, each one RLE packed on its own    *
+ * and ordered by distance from START, so the area around   *
+ * it can be played long before the rest of it arrives      *
+ * coordinates are big endian u16, sizes LEB128 varints     */
+namespace map_stream {
+
+constexpr int TILE          = 32;
+constexpr int TILES_X       = (Map::WIDTH  + TILE - 1) / TILE;
+constexpr int TILES_Y       = (Map::HEIGHT + TILE - 1) / TILE;
+constexpr int TILE_COUNT    = TILES_X * TILES_Y;
+static_assert(TILE % 16 == 0, "tiles are converted to pixels 16 cells at a time");
+
+// tile indices (x + y * TILES_X) nearest to the tile of cell x, y first
+std::array<uint16_t, TILE_COUNT> tile_order(int x, int y);
+
+std::vector<byte> encode(const Map &map);
+
+/* decodes the tiles of a stream arriving in pieces, in any *
+ * order, into the map as soon as all of their bytes are in */
+struct Decoder {
+    // the stream is size bytes, the map should be all UNKNOWN
+    void start(size_t size);
+    // bytes [offset, offset + size) of the stream are in now, false if malformed
+    bool on_bytes(const byte *stream, size_t offset, size_t size, Map &map);
+
+    bool has_header() const { return _has_header; }
+    bool is_resident(int tile_x, int tile_y) const;
+    // every tile up to radius tiles away from the one of START
+    bool is_resident_around_start(int radius) const;
+    bool done() const { return _resident_count == TILE_COUNT; }
+
+private:
+    std::vector<bool>   _present;
+    size_t              _prefix     = 0;    // bytes present from the beginning
+    bool                _has_header = false;
+    int                 _start_x    = 0;    // tile of START
+    int                 _start_y    = 0;
+    std::array<uint16_t, TILE_COUNT>    _order;
+    // where the packed tiles begin in stream order, plus the end
+    std::array<size_t, TILE_COUNT + 1>  _offsets;
+    std::array<bool, TILE_COUNT>        _resident;
+    int                 _resident_count = 0;
+
+    // -1 malformed, 0 not all of it is in yet
+    int _parse_header(const byte *stream, Map &map);
+    bool _decode_tile(const byte *stream, int pos, Map &map);
+};
+
+};
+#endif //ADHTP_MAP_STREAM_HDR
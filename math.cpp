@@ -1,5 +1,4 @@
 #include "math.hpp"
-#include <cmath>
 
 Vector2D Vector2D::operator-(const Vector2D& other) const {
     return Vector2D(x - other.x, y - other.y);
@@ -7,18 +6,18 @@ Vector2D Vector2D::operator-(const Vector2D& other) const {
 Vector2D Vector2D::operator-() const {
     return Vector2D(-x, -y);
 }
-Vector2D Vector2D::operator*(float scalar) const {
+Vector2D Vector2D::operator*(Real scalar) const {
     return Vector2D(x * scalar, y * scalar);
 }
-float Vector2D::dot(const Vector2D& other) const {
+Real Vector2D::dot(const Vector2D& other) const {
     return x * other.x + y * other.y;
 }
-float Vector2D::length() const {
-    return std::sqrt(x * x + y * y);
+Real Vector2D::length() const {
+    return sqrt(x * x + y * y);
 }
 void Vector2D::normalize() {
-    float len = length();
-    if (len != 0.0f) {
+    Real len = length();
+    if (len != 0) {
         x /= len;
         y /= len;
     }
@@ -28,8 +27,8 @@ Vector2D reflect(const Vector2D& incidentRay, const Vector2D& surfaceNormal) {
     Vector2D incidentVector = -incidentRay;
     incidentVector.normalize();
 
-    float dotProduct = incidentVector.dot(surfaceNormal);
-    Vector2D reflectionVector = incidentVector - surfaceNormal * (2.0f * dotProduct);
+    Real dotProduct = incidentVector.dot(surfaceNormal);
+    Vector2D reflectionVector = incidentVector - surfaceNormal * (dotProduct * 2);
 
     reflectionVector.normalize();
     return reflectionVector;
@@ -1,15 +1,22 @@
 #ifndef ADHTP_MATH_HDR
 #define ADHTP_MATH_HDR
 
+#include "fixed.hpp"
+
+// the physics' number format, Q47.16, peers have to agree on it
+constexpr int PHYSICS_FRAC_BITS = 16;
+using Real = Fixed<PHYSICS_FRAC_BITS>;
+
 struct Vector2D {
-    float x;
-    float y;
-    Vector2D(float x, float y) : x(x), y(y) {}
+    Real x;
+    Real y;
+    constexpr Vector2D(Real x, Real y) : x(x), y(y) {}
+    bool operator==(const Vector2D&) const = default;
     Vector2D operator-(const Vector2D& other) const;
     Vector2D operator-() const;
-    Vector2D operator*(float scalar) const;
-    float dot(const Vector2D& other) const;
-    float length() const;
+    Vector2D operator*(Real scalar) const;
+    Real dot(const Vector2D& other) const;
+    Real length() const;
     void normalize();
 };
 
@@ -1,18 +1,28 @@
 #include "types.hpp"
 #include "networking.hpp"
+#include "SPSCQueue.hpp"
+#include "PeerTable.hpp"
+#include "wire.hpp"
+#include "MapBroadcast.hpp"
 
 #include <unistd.h>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <thread>
 
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
 #include <arpa/inet.h>
+#include <linux/filter.h>
 #include <linux/wireless.h>
 
 namespace networking {
@@ -20,136 +30,739 @@ namespace networking {
 bool setup_wlan(int sock);
 bool setup_interface(int sock);
 bool set_iface_down(int sock);
+void net_loop();
+void wake_net_thread();
+void flush_broadcasts();
+
+/* ------------------ wire format ------------------ *
+ * a datagram is a header followed by bit packed     *
+ * messages, each one starts with its kind and the   *
+ * list ends with End, layouts are wire::Schemas     */
+constexpr byte   WIRE_VERSION   = 6;
+// stays under the MTU of the link
+constexpr size_t MAX_DATAGRAM   = 1200;
+
+struct Header {
+    byte    version;
+    byte    player_num;
+    u16     session;
+    uint    seq;
+};
+using HeaderSchema = wire::Schema<
+    wire::Field<&Header::version,       8>,
+    wire::Field<&Header::player_num,    8>,
+    wire::Field<&Header::session,       16>,
+    wire::Field<&Header::seq,           32>>;
+constexpr size_t HEADER_SIZE = HeaderSchema::BITS / 8;
+
+enum class MsgKind: byte {
+    End,
+    Hello,      // Opcode::Hello
+    MapInfo,    // Opcode::Ack
+    MapDone,    // Opcode::Done_Map
+    State,      // Opcode::Coord
+    StateAck,   // which of the peer's states were received
+    Segment,    // a piece of the map or a parity, broadcast to every downloader
+    SegmentNack,// which segments a peer misses, unicast back to the map's owner
+    Strokes,    // Opcode::Stroke, a run of them by sequence number
+    StrokeAck,  // every stroke of a peer up to a seq arrived
+    Inputs,     // Opcode::Input, the last INPUT_HISTORY ticks of them
+    Sync,       // Opcode::Sync
+};
+constexpr uint KIND_BITS = 4;
 
-constexpr uint SIZE_PKT = sizeof(Packet);
+struct MapInfoMsg {
+    uint    packed;
+    uint    raw;
+    u64     hash_hi;
+    u64     hash_lo;
+};
+using MapInfoSchema = wire::Schema<
+    wire::Field<&MapInfoMsg::packed,    32>,
+    wire::Field<&MapInfoMsg::raw,       32>,
+    wire::Field<&MapInfoMsg::hash_hi,   64>,
+    wire::Field<&MapInfoMsg::hash_lo,   64>>;
+
+/* position is in pixels of the 800x600 map, the velocity *
+ * per simulation step                                    */
+struct PlayerState {
+    i32     x;
+    i32     y;
+    float   vel_x;
+    float   vel_y;
+};
+using StateSchema = wire::Schema<
+    wire::Field<&PlayerState::x,                    11>,
+    wire::Field<&PlayerState::y,                    11>,
+    wire::Quantized<&PlayerState::vel_x, -16.f, 16.f, 12>,
+    wire::Quantized<&PlayerState::vel_y, -16.f, 16.f, 12>>;
+
+/* bit i of the mask - state (seq - 1 - i) was received */
+struct StateAckMsg {
+    byte    peer;
+    u16     seq;
+    uint    mask;
+};
+using StateAckSchema = wire::Schema<
+    wire::Field<&StateAckMsg::peer,     8>,
+    wire::Field<&StateAckMsg::seq,      16>,
+    wire::Field<&StateAckMsg::mask,     32>>;
+
+/* a State message is this and the states oldest first, *
+ * the offset goes back from seq to the base if any      */
+struct StatesMsg {
+    u16     seq;
+    byte    copies;     // states - 1
+    bool    has_base;
+    byte    base_offset;
+};
+using StatesSchema = wire::Schema<
+    wire::Field<&StatesMsg::seq,            16>,
+    wire::Field<&StatesMsg::copies,         2, 1>,
+    wire::Field<&StatesMsg::has_base,       1, 0>,
+    wire::Field<&StatesMsg::base_offset,    6>>;
+
+// states kept for delta encoding, on both ends
+constexpr uint STATE_HISTORY    = 64;
+// every State message repeats the last few states, a lost datagram costs nothing
+constexpr uint STATE_COPIES     = 3;
+constexpr uint ACK_WINDOW       = 32;
+constexpr uint MAX_STATE_BITS   = KIND_BITS + StatesSchema::BITS
+                                + STATE_COPIES * StateSchema::MAX_DELTA_BITS;
+static_assert(STATE_COPIES <= 4 && STATE_HISTORY <= 64);
+
+/* the segment's bytes follow its header, byte aligned or not *
+ * the index of a parity is its group                         */
+struct SegmentMsg {
+    bool    parity;
+    uint    index;
+    uint    size;
+};
+using SegmentSchema = wire::Schema<
+    wire::Field<&SegmentMsg::parity,    1, 0>,
+    wire::Field<&SegmentMsg::index,     20>,
+    wire::Field<&SegmentMsg::size,      11>>;
+constexpr uint MAX_SEGMENT_BITS = KIND_BITS + SegmentSchema::BITS + SEGMENT_SIZE * 8;
+static_assert(SEGMENT_SIZE < (1 << 11));
+static_assert(HEADER_SIZE * 8 + MAX_SEGMENT_BITS + KIND_BITS <= MAX_DATAGRAM * 8);
+
+/* bit i of the mask - segment first + 1 + i is missing too *
+ * first past the last segment once the map is complete     */
+struct SegmentNackMsg {
+    uint    first;
+    u64     mask;
+};
+using SegmentNackSchema = wire::Schema<
+    wire::Field<&SegmentNackMsg::first,     20>,
+    wire::Field<&SegmentNackMsg::mask,      NACK_BITS>>;
+
+// the downloading side repeats its NACKs this often, the first one asks for the map
+constexpr double NACK_INTERVAL  = 0.1;
+
+struct StrokeMsg {
+    uint    lamport;
+    u16     x;
+    u16     y;
+    byte    cell;
+    byte    size;
+};
+using StrokeSchema = wire::Schema<
+    wire::Field<&StrokeMsg::lamport,    32>,
+    wire::Field<&StrokeMsg::x,          10>,
+    wire::Field<&StrokeMsg::y,          10>,
+    wire::Field<&StrokeMsg::cell,       8>,
+    wire::Field<&StrokeMsg::size,       6>>;
+// a Strokes message is this and the strokes from first on
+struct StrokesMsg {
+    u16     first;
+    byte    count;      // strokes - 1
+};
+using StrokesSchema = wire::Schema<
+    wire::Field<&StrokesMsg::first,     16>,
+    wire::Field<&StrokesMsg::count,     6>>;
+constexpr uint STROKES_PER_MSG  = 64;
+constexpr uint MAX_STROKES_BITS = KIND_BITS + StrokesSchema::BITS
+                                + STROKES_PER_MSG * StrokeSchema::BITS;
+static_assert(STROKES_PER_MSG <= 64);
+// unacked strokes are sent again this often, at most this many each time
+constexpr double STROKE_INTERVAL = 0.1;
+constexpr uint STROKE_BURST     = 4 * STROKES_PER_MSG;
+
+struct StrokeAckMsg {
+    byte    peer;
+    u16     seq;
+};
+using StrokeAckSchema = wire::Schema<
+    wire::Field<&StrokeAckMsg::peer,    8>,
+    wire::Field<&StrokeAckMsg::seq,     16>>;
+
+/* an Inputs message is this and the runs newest *
+ * first, a held key is a single run             */
+struct InputsMsg {
+    uint    tick;       // the newest
+    byte    runs;       // runs - 1
+};
+using InputsSchema = wire::Schema<
+    wire::Field<&InputsMsg::tick,       32>,
+    wire::Field<&InputsMsg::runs,       6>>;
+struct InputRunMsg {
+    byte    input;      // direction | jump << 2
+    byte    length;     // ticks - 1
+};
+using InputRunSchema = wire::Schema<
+    wire::Field<&InputRunMsg::input,    3>,
+    wire::Field<&InputRunMsg::length,   6>>;
+// every datagram repeats this many ticks, a run of lost ones costs nothing
+constexpr uint INPUT_HISTORY    = 64;
+constexpr uint MAX_INPUTS_BITS  = KIND_BITS + InputsSchema::BITS
+                                + INPUT_HISTORY * InputRunSchema::BITS;
+static_assert(INPUT_HISTORY <= 64);
+
+/* not delta encoded and sent once, the next heartbeat *
+ * carries a newer one, the velocities are raw Real    */
+struct SyncMsg {
+    uint    tick;
+    i32     x;
+    i32     y;
+    i32     vel_x;
+    i32     vel_y;
+    bool    has_jumped;
+};
+using SyncSchema = wire::Schema<
+    wire::Field<&SyncMsg::tick,         32>,
+    wire::Field<&SyncMsg::x,            11>,
+    wire::Field<&SyncMsg::y,            11>,
+    wire::Field<&SyncMsg::vel_x,        24>,
+    wire::Field<&SyncMsg::vel_y,        24>,
+    wire::Field<&SyncMsg::has_jumped,   1, 0>>;
+
+struct StateSlot {
+    uint        seq     = 0;    // 0 - empty
+    PlayerState state   = {};
+};
 
 struct PlayerEntry {
     byte        player_num;
 
-    int         tcp_sock            = -1;
-    uint        tcp_bytes_sent      = 0;
-    uint        tcp_buffer_size     = 0;
-    sockaddr_in saddr_in; 
-    size_t      last_seq            = 0;
+    sockaddr_in saddr_in;   // where its datagrams come from, unicasts go there
+
+    // the peer has all of the map we serve
+    bool        map_done            = false;
+
+    // the peer's states, seq are extended from the 16 bits on the wire
+    std::array<StateSlot, STATE_HISTORY> states = {};
+    uint        state_seq           = 0;    // newest received
+    uint        state_mask          = 0;    // older ones received, acked back
+
+    // our states the peer has acknowledged
+    uint        acked_seq           = 0;
+    uint        acked_mask          = 0;
+
+    // the peer's strokes received in order, acked back once any arrived
+    uint        stroke_seq          = 0;
+    bool        heard_strokes       = false;
+    // ours it has, every one up to it
+    uint        stroke_acked        = 0;
+
+    // the newest of the peer's input ticks passed on
+    uint        input_tick          = 0;
 };
 
-/* player_num -> player_info entry                  */
-static std::unordered_map<byte, PlayerEntry>    player_entries;
+/* player_num -> player_info entry, owned by the network thread */
+static PeerTable<PlayerEntry>   player_entries;
 
 static constexpr uint MAX_EVENTS = 8;
 static epoll_event ev, events[MAX_EVENTS];
 
 static uint     THIS_SEQ_NUM = 0;
 
+/* our sent states, the newest one is sent_seq      */
+static std::array<StateSlot, STATE_HISTORY> sent_states;
+static uint     sent_seq = 0;
+
 static int      send_udp_sfd = -1;
 static int      recv_udp_sfd = -1;
 
-static int      tcp_sfd = -1;
-static bool     is_tcp_listening    = false;
-static bool     is_tcp_reading      = false;
-
-/* used to point to bytes in the TCP stream buffer  */
-static size_t   tcp_buffer_pointer = 0;
-static size_t   tcp_buffer_size;
-
-/* buffer assigned to receive bytes of a map th.TCP */
-static std::vector<byte> tcp_buffer;
+/* bytes broadcast to every player downloading the  *
+ * map, not owned, usually the mapped map file      */
+static const byte   *map_source = nullptr;
+static size_t       map_source_size = 0;
+static bool         is_serving      = false;
+static BroadcastSender  map_sender;
+
+/* the map being downloaded from map_owner          */
+static BroadcastReceiver map_receiver;
+static std::vector<uint> map_arrived;   // segments a datagram completed
+static byte         map_owner       = 0;
+static bool         map_received    = false;
+static bool         nack_due        = false;
+static double       next_nack       = 0;
+
+/* our strokes, seq is the index + 1, and the last    *
+ * one sent, the older are resent until acked         */
+static std::vector<StrokeMsg>   sent_strokes;
+static uint         strokes_sent_end    = 0;
+static double       next_strokes        = 0;
+static bool         stroke_acks_due     = false;
+
+/* our inputs by tick, the newest one is input_tick */
+static std::array<byte, INPUT_HISTORY> sent_inputs;
+static uint         input_tick          = 0;
+static bool         inputs_due          = false;
+
+/* map segments share the medium with everything else */
+static Pacer        pacer;
 
 static socklen_t sl = 0;
 
 static int epollfd = -1;
 
 static sockaddr_in  broadcast_addr;
-static sockaddr_in  tcp_this_addr;
+static sockaddr_in  listen_addr;
 static in_addr_t    local_addr;
 
 static NetConfig config;
-// network to hardware
-Packet ntohpkt(Packet &pkt) {
-    Packet h_pkt = {
-        .opcode             = pkt.opcode,
-        .player_num         = pkt.player_num,
-        .seq                = ntohl(pkt.seq),
-        .payload            = pkt.payload
-    };
+/* packets of other games sharing the channel carry a different one */
+static u16          session_id = 0;
+
+/* requests from the game thread, executed by the network thread */
+struct Command {
+    enum Kind: byte {
+        Broadcast,
+        RequestMap,
+        ServeMap,
+    } kind;
+    Packet  pkt;
+    byte    player_num;
+    uint    byte_count;
+};
 
-    uint payload_size = sizeof(h_pkt.payload) / sizeof(uint);
-    uint *buff = (uint*)&h_pkt.payload;
-    for (uint i = 0; i < payload_size; ++i) {
-        buff[i] = ntohl(buff[i]);
+static constexpr size_t QUEUE_SIZE = 1024;
+
+/* network thread -> game thread                    */
+static SPSCQueue<Packet, QUEUE_SIZE>    inbound;
+/* game thread -> network thread                    */
+static SPSCQueue<Command, QUEUE_SIZE>   outbound;
+
+/* wakes the network thread up from epoll_wait      */
+static int                  wake_fd = -1;
+static std::thread          net_thread;
+static std::atomic<bool>    is_running = false;
+
+static std::atomic<u64>     packets_received = 0;
+static std::atomic<u64>     packets_sent     = 0;
+static std::atomic<u64>     recv_calls       = 0;
+static std::atomic<u64>     send_calls       = 0;
+
+/* preallocated slots for recvmmsg / sendmmsg, only *
+ * touched by the network thread                    */
+static constexpr uint RECV_BATCH = 32;
+static byte         recv_slots[RECV_BATCH][MAX_DATAGRAM];
+static sockaddr_in  recv_addrs[RECV_BATCH];
+static iovec        recv_iovs[RECV_BATCH];
+static mmsghdr      recv_msgs[RECV_BATCH];
+
+static constexpr uint SEND_BATCH = 32;
+static byte         send_slots[SEND_BATCH][MAX_DATAGRAM];
+static sockaddr_in  send_addrs[SEND_BATCH];
+static iovec        send_iovs[SEND_BATCH];
+static mmsghdr      send_msgs[SEND_BATCH];
+static uint         send_count = 0;
+/* datagram being filled in send_slots[send_count]  *
+ * going to send_addrs[send_count]                  */
+static wire::BitWriter  send_writer(nullptr, 0);
+static bool             send_open = false;
+/* the game broadcast something this round          */
+static bool             has_broadcast = false;
+
+// seconds on a monotonic clock
+double now_sec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the extended seq closest to `near` with the given low 16 bits
+uint extend_seq(uint near, u16 seq) {
+    return near + int16_t(u16(seq - u16(near)));
+}
+
+StateSlot& state_slot(std::array<StateSlot, STATE_HISTORY> &history, uint seq) {
+    return history[seq % STATE_HISTORY];
+}
+
+// marks the peer's state as received, false if it was seen already
+bool receive_state(PlayerEntry &entry, uint seq) {
+    auto &newest = entry.state_seq;
+    auto &mask = entry.state_mask;
+    if (newest == 0 || seq > newest) {
+        const uint shift = newest == 0 ? ACK_WINDOW + 1 : seq - newest;
+        // the previous newest becomes bit shift - 1
+        mask = shift > ACK_WINDOW ? 0 : (u64(mask) << shift | u64(1) << (shift - 1));
+        newest = seq;
+        return true;
     }
-    return h_pkt;
-};
-// hardware to network
-Packet htonpkt(Packet &pkt) {
-    Packet n_pkt = {
-        .opcode             = pkt.opcode,
-        .player_num         = pkt.player_num,
-        .seq                = htonl(pkt.seq),
-        .payload            = pkt.payload
-    };
+    if (seq == newest) return false;
+    const uint back = newest - seq - 1;
+    if (back >= ACK_WINDOW || mask >> back & 1) return false;
+    mask |= 1u << back;
+    return true;
+}
+
+bool has_received(const PlayerEntry &entry, uint seq) {
+    if (entry.acked_seq == 0 || seq > entry.acked_seq) return false;
+    if (seq == entry.acked_seq) return true;
+    const uint back = entry.acked_seq - seq - 1;
+    return back < ACK_WINDOW && entry.acked_mask >> back & 1;
+}
 
-    uint payload_size = sizeof(n_pkt.payload) / sizeof(uint);
-    uint *buff = (uint*)&n_pkt.payload;
-    for (uint i = 0; i < payload_size; ++i) {
-        buff[i] = htonl(buff[i]);
+// the newest of our states every known peer has, 0 if there is none
+uint pick_base() {
+    if (player_entries.size() == 0) return 0;
+    for (uint seq = sent_seq; seq > 0 && sent_seq - seq < STATE_HISTORY; --seq) {
+        bool everyone = true;
+        for (auto [_, entry]: player_entries) {
+            if (!has_received(entry, seq)) {
+                everyone = false;
+                break;
+            }
+        }
+        if (everyone) return seq;
     }
-    return n_pkt;
-};
+    return 0;
+}
 
-// TCP READING
-bool connect_to_player(byte player_num, uint byte_count) {
-    if (!player_entries.contains(player_num)) {
-        LOG_ERR("FATAL: CANNOT CONNECT TO NONEXISTING PLAYER!!!");
-        return false;
+// sends the datagrams closed so far in one syscall
+void send_datagrams();
+
+bool same_addr(const sockaddr_in &a, const sockaddr_in &b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+void close_datagram();
+
+// starts a datagram to `to` in the next free send slot unless one is open
+wire::BitWriter& open_datagram(const sockaddr_in &to) {
+    if (send_open && !same_addr(send_addrs[send_count], to)) close_datagram();
+    if (!send_open) {
+        if (send_count == SEND_BATCH) send_datagrams();
+        send_addrs[send_count] = to;
+        send_writer = wire::BitWriter(send_slots[send_count], MAX_DATAGRAM);
+        HeaderSchema::write(send_writer, Header {
+            .version    = WIRE_VERSION,
+            .player_num = config.pr_numb,
+            .session    = session_id,
+            .seq        = ++THIS_SEQ_NUM,
+        });
+        send_open = true;
     }
-    if (is_tcp_reading) {
-        LOG_DBG("Cannot connect twice to the same TCP sender");
-        return false;
+    return send_writer;
+}
+
+void close_datagram() {
+    if (!send_open) return;
+    send_writer.write(u64(MsgKind::End), KIND_BITS);
+    send_iovs[send_count].iov_len = send_writer.size();
+    ++send_count;
+    send_open = false;
+}
+
+// writer with room for a message of at most `bits`, the End included
+wire::BitWriter& reserve_message(uint bits, const sockaddr_in &to = broadcast_addr) {
+    auto &writer = open_datagram(to);
+    if (writer.bits_left() >= bits + KIND_BITS) return writer;
+    close_datagram();
+    return open_datagram(to);
+}
+
+/* the newest states, oldest first, each one against the base *
+ * every peer has acknowledged or in full if there is none    */
+void write_states() {
+    const uint copies = std::min(STATE_COPIES, sent_seq);
+    const uint base = pick_base();
+    const auto &base_state = state_slot(sent_states, base).state;
+
+    auto &writer = reserve_message(MAX_STATE_BITS);
+    writer.write(u64(MsgKind::State), KIND_BITS);
+    StatesSchema::write(writer, StatesMsg {
+        .seq            = u16(sent_seq),
+        .copies         = byte(copies - 1),
+        .has_base       = base != 0,
+        .base_offset    = byte(base != 0 ? sent_seq - base : 0),
+    });
+    for (uint seq = sent_seq - copies + 1; seq <= sent_seq; ++seq) {
+        const auto &state = state_slot(sent_states, seq).state;
+        if (base != 0) StateSchema::write_delta(writer, state, base_state);
+        else StateSchema::write(writer, state);
     }
-    // retr addr from recvd UDP packets 
-    auto addr = player_entries.at(player_num).saddr_in;
-    // the rest of the addr is identical
-    addr.sin_port = htons(config.port - 1);
+}
 
-    ev.events = EPOLLIN | EPOLLET;
-    ev.data.fd = tcp_sfd;
+// which of every peer's states we have, only sent along other messages
+void write_state_acks() {
+    for (auto [num, entry]: player_entries) {
+        if (entry.state_seq == 0) continue;
+        auto &writer = reserve_message(KIND_BITS + StateAckSchema::BITS);
+        writer.write(u64(MsgKind::StateAck), KIND_BITS);
+        StateAckSchema::write(writer, StateAckMsg {
+            .peer   = num,
+            .seq    = u16(entry.state_seq),
+            .mask   = entry.state_mask,
+        });
+    }
+}
 
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, tcp_sfd, &ev) == -1) {
-        LOG_ERR("Failed to add TCP socket to epoll.");
-        perror("What");
-        return false;
+// encodes the packet as a message of this round's datagram, sent by flush_broadcasts
+void send_broadcast(Packet &pkt) {
+    has_broadcast = true;
+    switch (pkt.opcode) {
+        case Opcode::Hello:
+            reserve_message(KIND_BITS).write(u64(MsgKind::Hello), KIND_BITS);
+            break;
+        case Opcode::Ack: {
+            MapInfoMsg info = {
+                .packed = pkt.payload.map_buff_size.packed,
+                .raw    = pkt.payload.map_buff_size.raw,
+            };
+            for (int i = 0; i < 8; ++i) {
+                info.hash_hi = info.hash_hi << 8 | pkt.payload.map_hash[i];
+                info.hash_lo = info.hash_lo << 8 | pkt.payload.map_hash[i + 8];
+            }
+            auto &writer = reserve_message(KIND_BITS + MapInfoSchema::BITS);
+            writer.write(u64(MsgKind::MapInfo), KIND_BITS);
+            MapInfoSchema::write(writer, info);
+            break;
+        }
+        case Opcode::Done_Map:
+            reserve_message(KIND_BITS).write(u64(MsgKind::MapDone), KIND_BITS);
+            break;
+        case Opcode::Stroke:
+            sent_strokes.push_back(StrokeMsg {
+                .lamport    = pkt.payload.stroke.lamport,
+                .x          = pkt.payload.stroke.x,
+                .y          = pkt.payload.stroke.y,
+                .cell       = pkt.payload.stroke.cell,
+                .size       = pkt.payload.stroke.size,
+            });
+            break;
+        case Opcode::Input:
+            input_tick = pkt.payload.input.tick;
+            sent_inputs[input_tick % INPUT_HISTORY] =
+                (pkt.payload.input.direction & 3) | pkt.payload.input.jump << 2;
+            inputs_due = true;
+            break;
+        case Opcode::Sync: {
+            const auto &sync = pkt.payload.sync;
+            auto &writer = reserve_message(KIND_BITS + SyncSchema::BITS);
+            writer.write(u64(MsgKind::Sync), KIND_BITS);
+            SyncSchema::write(writer, SyncMsg {
+                .tick       = sync.tick,
+                .x          = sync.x,
+                .y          = sync.y,
+                .vel_x      = sync.vel_x,
+                .vel_y      = sync.vel_y,
+                .has_jumped = sync.has_jumped,
+            });
+            break;
+        }
+        case Opcode::Coord:
+            ++sent_seq;
+            state_slot(sent_states, sent_seq) = {
+                .seq    = sent_seq,
+                .state  = {
+                    .x      = pkt.payload.move.coord[0],
+                    .y      = pkt.payload.move.coord[1],
+                    .vel_x  = pkt.payload.move.d_vel[0],
+                    .vel_y  = pkt.payload.move.d_vel[1],
+                },
+            };
+            write_states();
+            break;
+        default:
+            LOG_ERR("Cannot send a packet with opcode {}", byte(pkt.opcode));
+            break;
     }
+}
 
-     if (connect(tcp_sfd, (sockaddr *)&addr, sizeof(addr))) {
-        if (errno == EINPROGRESS) {
-            LOG_DBG("Connecting to TCP sender...");
+// our inputs of the last INPUT_HISTORY ticks, run length encoded
+void write_inputs() {
+    std::array<InputRunMsg, INPUT_HISTORY> runs;
+    uint run_count = 0;
+    const uint count = std::min(input_tick, INPUT_HISTORY);
+    for (uint tick = input_tick; tick > input_tick - count; --tick) {
+        const byte input = sent_inputs[tick % INPUT_HISTORY];
+        if (run_count > 0 && runs[run_count - 1].input == input) {
+            ++runs[run_count - 1].length;
         } else {
-            LOG_ERR("Failed to connect to TCP sender.");
-            perror("What");
-            return false;
+            runs[run_count++] = {.input = input, .length = 0};
         }
     }
-    is_tcp_reading = true;
-    tcp_buffer_size = byte_count;
-    LOG_DBG("Connected, bytes to read from TCP sender: {}.", byte_count);
-    tcp_buffer = std::vector<byte>(byte_count);
-    return true; 
+    auto &writer = reserve_message(MAX_INPUTS_BITS);
+    writer.write(u64(MsgKind::Inputs), KIND_BITS);
+    InputsSchema::write(writer, InputsMsg {
+        .tick   = input_tick,
+        .runs   = byte(run_count - 1),
+    });
+    for (uint i = 0; i < run_count; ++i) InputRunSchema::write(writer, runs[i]);
 }
 
-void broadcast(Packet &pkt) {
-    ++THIS_SEQ_NUM;
-    pkt.seq = THIS_SEQ_NUM;
-    Packet n_pkt = htonpkt(pkt);
-    socklen_t slen = sizeof(broadcast_addr);
-    int rv = sendto(send_udp_sfd, (void*)&n_pkt, sizeof(n_pkt), 0, (sockaddr*)&broadcast_addr, slen);
-    if (rv < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return;
+// the acks ride along with whatever the game broadcast this round
+void flush_broadcasts() {
+    if (inputs_due) write_inputs();
+    inputs_due = false;
+    if (has_broadcast) write_state_acks();
+    has_broadcast = false;
+    close_datagram();
+    send_datagrams();
+}
+
+// unicast address of the peer's receiving socket
+sockaddr_in peer_addr(const PlayerEntry &entry) {
+    auto addr = entry.saddr_in;
+    addr.sin_port = htons(config.port);
+    return addr;
+}
+
+std::span<const byte> segment_data(BroadcastSender::Send send) {
+    return send.parity ? map_sender.parity(send.index) : map_sender.segment(send.index);
+}
+
+void write_segment(BroadcastSender::Send send, double now) {
+    const auto data = segment_data(send);
+    auto &writer = reserve_message(MAX_SEGMENT_BITS);
+    writer.write(u64(MsgKind::Segment), KIND_BITS);
+    SegmentSchema::write(writer, SegmentMsg {
+        .parity = send.parity,
+        .index  = send.index,
+        .size   = uint(data.size()),
+    });
+    for (byte b: data) writer.write(b, 8);
+    map_sender.on_sent(send, now);
+}
+
+void write_segment_nack() {
+    auto *owner = player_entries.find(map_owner);
+    if (!owner) return;
+    auto &writer = reserve_message(KIND_BITS + SegmentNackSchema::BITS, peer_addr(*owner));
+    writer.write(u64(MsgKind::SegmentNack), KIND_BITS);
+    SegmentNackSchema::write(writer, SegmentNackMsg {
+        .first  = map_receiver.first_missing(),
+        .mask   = map_receiver.mask(),
+    });
+}
+
+/* paces the map out to every peer downloading it, each segment  *
+ * broadcast once plus what was NACKed, and NACKs the download   *
+ * in progress, returns when it has to run again, 0 if never     */
+double run_transfers(double now, std::vector<Packet> &packets) {
+    double wake = 0;
+    auto wake_at = [&](double time) {
+        if (time > 0 && (wake == 0 || time < wake)) wake = time;
+    };
+
+    BroadcastSender::Send send;
+    while (map_sender.next(send)) {
+        const size_t bytes = HEADER_SIZE + segment_data(send).size();
+        if (!pacer.try_take(bytes, now)) {
+            wake_at(pacer.ready_at(bytes, now));
+            break;
+        }
+        write_segment(send, now);
+    }
+
+    if (map_receiver.active()) {
+        if (map_receiver.done() && !map_received) {
+            map_received = true;
+            // the owner learns it is done from one last NACK
+            nack_due = true;
+            // send to itself
+            packets.push_back(Packet {
+                .opcode     = Opcode::Done_Map,
+                .player_num = config.pr_numb,
+                .seq        = 0,
+            });
+        }
+        // until the map is complete the NACKs repeat, they also ask for it
+        if (nack_due || (!map_received && now >= next_nack)) {
+            write_segment_nack();
+            nack_due = false;
+            next_nack = now + NACK_INTERVAL;
+        }
+        if (!map_received) wake_at(next_nack);
+    }
+    return wake;
+}
+
+// our strokes [first, last] by seq
+void write_strokes(uint first, uint last) {
+    while (first <= last) {
+        const uint count = std::min(last - first + 1, STROKES_PER_MSG);
+        auto &writer = reserve_message(MAX_STROKES_BITS);
+        writer.write(u64(MsgKind::Strokes), KIND_BITS);
+        StrokesSchema::write(writer, StrokesMsg {
+            .first  = u16(first),
+            .count  = byte(count - 1),
+        });
+        for (uint seq = first; seq < first + count; ++seq) {
+            StrokeSchema::write(writer, sent_strokes[seq - 1]);
+        }
+        first += count;
+    }
+}
+
+void write_stroke_acks() {
+    for (auto [num, entry]: player_entries) {
+        if (!entry.heard_strokes) continue;
+        auto &writer = reserve_message(KIND_BITS + StrokeAckSchema::BITS);
+        writer.write(u64(MsgKind::StrokeAck), KIND_BITS);
+        StrokeAckSchema::write(writer, StrokeAckMsg {
+            .peer   = num,
+            .seq    = u16(entry.stroke_seq),
+        });
+    }
+}
+
+/* broadcasts new strokes right away and, every STROKE_INTERVAL, *
+ * the oldest ones a peer hasn't acked, returns when it has to   *
+ * run again, 0 if every peer has all of them                    */
+double run_strokes(double now) {
+    if (stroke_acks_due) {
+        write_stroke_acks();
+        stroke_acks_due = false;
+    }
+    const uint last = sent_strokes.size();
+    if (strokes_sent_end < last) {
+        write_strokes(strokes_sent_end + 1, last);
+        strokes_sent_end = last;
+        next_strokes = now + STROKE_INTERVAL;
+    }
+    uint first = last + 1;
+    for (auto [_, entry]: player_entries) {
+        first = std::min(first, entry.stroke_acked + 1);
+    }
+    if (first > last) return 0;
+    if (now >= next_strokes) {
+        write_strokes(first, std::min(last, first + STROKE_BURST - 1));
+        next_strokes = now + STROKE_INTERVAL;
+    }
+    return next_strokes;
+}
+
+void send_datagrams() {
+    uint sent = 0;
+    while (sent < send_count) {
+        int rv = sendmmsg(send_udp_sfd, send_msgs + sent, send_count - sent, 0);
+        send_calls.fetch_add(1, std::memory_order_relaxed);
+        if (rv < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERR("Failed to send: {}", rv);
+                perror("what");
+            }
+            break;
         }
-        LOG_ERR("Failed to send: {}", rv);
-        perror("what");
+        sent += rv;
+        packets_sent.fetch_add(rv, std::memory_order_relaxed);
     }
+    send_count = 0;
 }
 
 bool bind_addr(c_str device) {
@@ -163,9 +776,10 @@ bool bind_addr(c_str device) {
         LOG_ERR("Failed to bind device to the UDP socket");
         return false;
     }
-    if (setsockopt(tcp_sfd, SOL_SOCKET, SO_BINDTODEVICE,
+    // the receiving socket listens on every address, but only of this device
+    if (setsockopt(recv_udp_sfd, SOL_SOCKET, SO_BINDTODEVICE,
                    (void *)&ifr, sizeof(ifr)) < 0) {
-        LOG_ERR("Failed to bind device to the TCP socket");
+        LOG_ERR("Failed to bind device to the Recv UDP socket");
         return false;
     }
 
@@ -178,17 +792,8 @@ bool bind_addr(c_str device) {
         LOG_ERR("Failed to set SO_REUSEADDR for Recv UDP sock");
         return false;
     }
-    if (setsockopt(tcp_sfd, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr)) < 0) {
-        LOG_ERR("Failed to set SO_REUSEADDR for TCP sock");
-        return false;
-    }
-    // RECV UDP binding
-    if (bind(recv_udp_sfd, (sockaddr*)&broadcast_addr, sizeof(broadcast_addr)) == -1) {
-        LOG_ERR("Error during socket binding");
-		return false;
-    };
-    // TCP binding
-    if (bind(tcp_sfd, (sockaddr*)&tcp_this_addr, sizeof(tcp_this_addr)) == -1) {
+    // RECV UDP binding, broadcasts and unicasts alike
+    if (bind(recv_udp_sfd, (sockaddr*)&listen_addr, sizeof(listen_addr)) == -1) {
         LOG_ERR("Error during socket binding");
 		return false;
     };
@@ -196,6 +801,55 @@ bool bind_addr(c_str device) {
     return true;
 }
 
+// 16 bit FNV-1a of the ESSID, games on other networks are filtered out
+u16 make_session_id(c_str essid) {
+    uint hash = 2166136261u;
+    for (c_str c = essid; *c; ++c) {
+        hash = (hash ^ byte(*c)) * 16777619u;
+    }
+    return u16(hash ^ (hash >> 16));
+}
+
+/* classic BPF program for the receiving UDP socket, drops   *
+ * in the kernel: own broadcasts, wrong sizes, other wire    *
+ * versions and packets of other sessions                    *
+ * a UDP socket filter sees the packet from the UDP header   */
+bool attach_recv_filter(int sfd) {
+    constexpr uint UDP_HDR      = 8;
+    constexpr uint OFF_VERSION  = UDP_HDR;
+    constexpr uint OFF_SESSION  = UDP_HDR + 2;
+    constexpr uint OFF_SRC_IP   = SKF_NET_OFF + 12;
+
+    sock_filter code[] = {
+        // length, the header and at least End
+        BPF_STMT(BPF_LD  | BPF_W | BPF_LEN, 0),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, UDP_HDR + HEADER_SIZE + 1, 0, 8),
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, UDP_HDR + MAX_DATAGRAM, 7, 0),
+        // source address, loaded in host order
+        BPF_STMT(BPF_LD  | BPF_W | BPF_ABS, OFF_SRC_IP),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(local_addr), 5, 0),
+        // wire version
+        BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, OFF_VERSION),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, WIRE_VERSION, 0, 3),
+        // session, the header is in network order
+        BPF_STMT(BPF_LD  | BPF_H | BPF_ABS, OFF_SESSION),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, session_id, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xFFFF),
+        // drop
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    sock_fprog prog = {
+        .len    = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+    if (setsockopt(sfd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+        LOG_ERR("Failed to attach the socket filter, filtering in userspace");
+        perror("What");
+        return false;
+    }
+    return true;
+}
+
 bool enable_sock_broadcast(int sfd) {
     int broadcastEnable = 1;
     if (setsockopt(sfd, SOL_SOCKET, SO_BROADCAST, 
@@ -229,13 +883,21 @@ bool create_epoll() {
         perror("What");
         return false;
     }
-    // TCP
-    flags = fcntl(tcp_sfd, F_GETFL, 0);
-    if (fcntl(tcp_sfd, F_SETFL, flags | O_NONBLOCK) == -1) {
-        LOG_ERR("Nonblocking socket error for TCP sock");
+
+    // ADDING WAKE UP EVENT TO EPOLL
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (wake_fd == -1) {
+        LOG_ERR("Eventfd creation failed");
         perror("What");
         return false;
-    }    
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, wake_fd, &ev) == -1) {
+        LOG_ERR("Epoll_ctl failed when adding the wake up event");
+        perror("What"); 
+        return false;
+    }
 
     // ADDING UDP SOCKET TO EPOLL
     ev.events = EPOLLIN | EPOLLET;
@@ -269,10 +931,10 @@ bool setup(NetConfig &cfg) {
         .sin_port       = htons(config.port),
         .sin_addr       = {inet_addr(config.bd_addr)}
     };
-    // TCP address to accept connections from PORT = PORT - 1
-    tcp_this_addr = {
+    // everything is received on the one port
+    listen_addr = {
         .sin_family     = AF_INET,
-        .sin_port       = htons(config.port - 1),
+        .sin_port       = htons(config.port),
         .sin_addr       = {in_addr_t{INADDR_ANY}},
     };
 
@@ -289,12 +951,6 @@ bool setup(NetConfig &cfg) {
         perror("What");
         return false;
     }
-    tcp_sfd         = socket(AF_INET, SOCK_STREAM,  IPPROTO_TCP);
-    if (tcp_sfd < 0) {
-        LOG_ERR("Socket tcp error!");
-        perror("What");
-        return false;
-    }
     if (!enable_sock_broadcast(send_udp_sfd)) {
         return false;
     }
@@ -302,21 +958,45 @@ bool setup(NetConfig &cfg) {
         perror("What"); 
         return false;
     };
+    session_id = make_session_id(config.essid);
+    attach_recv_filter(recv_udp_sfd);
     if (!create_epoll()) {
         return false;
     }
+    for (uint i = 0; i < RECV_BATCH; ++i) {
+        recv_iovs[i] = {.iov_base = recv_slots[i], .iov_len = MAX_DATAGRAM};
+        recv_msgs[i] = {};
+        recv_msgs[i].msg_hdr.msg_name       = &recv_addrs[i];
+        recv_msgs[i].msg_hdr.msg_namelen    = sizeof(recv_addrs[i]);
+        recv_msgs[i].msg_hdr.msg_iov        = &recv_iovs[i];
+        recv_msgs[i].msg_hdr.msg_iovlen     = 1;
+    }
+    for (uint i = 0; i < SEND_BATCH; ++i) {
+        send_iovs[i] = {.iov_base = send_slots[i], .iov_len = 0};
+        send_msgs[i] = {};
+        send_msgs[i].msg_hdr.msg_name       = &send_addrs[i];
+        send_msgs[i].msg_hdr.msg_namelen    = sizeof(send_addrs[i]);
+        send_msgs[i].msg_hdr.msg_iov        = &send_iovs[i];
+        send_msgs[i].msg_hdr.msg_iovlen     = 1;
+    }
+
+    // sockets are owned by the network thread from now on
+    is_running = true;
+    net_thread = std::thread(net_loop);
     return true;
 }
 
 void destroy() {
     LOG_DBG("Cleaning up networking resources...");
+    if (net_thread.joinable()) {
+        is_running = false;
+        wake_net_thread();
+        net_thread.join();
+    }
     if (send_udp_sfd >= 0)  close(send_udp_sfd);
     if (recv_udp_sfd >= 0)  close(recv_udp_sfd);
-    if (tcp_sfd >= 0)       close(tcp_sfd);
     if (epollfd >= 0)       close(epollfd);
-    for (auto& [_, info]: player_entries) {
-        close(info.tcp_sock);
-    }
+    if (wake_fd >= 0)       close(wake_fd);
 }
 
 // setup adhoc mode and essid
@@ -411,242 +1091,429 @@ bool setup_interface(int sock) {
     return true;
 }
 
-bool set_tcp_buffer(byte* byte_ptr, size_t size) {
-    tcp_buffer_size = size;
-    tcp_buffer = std::vector<byte>(size);
-    memcpy(tcp_buffer.data(), byte_ptr, size);
+bool set_map_source(const byte* byte_ptr, size_t size) {
+    map_source      = byte_ptr;
+    map_source_size = size;
     return true;
 }
 
-void recv_udp_packets(int fd, std::vector<Packet> &packets) {
-    sockaddr_in s_addr;
-    Packet pkt;
-    socklen_t sockl = sizeof(s_addr);
+/* decodes the State message, the states newer than any   *
+ * seen before are passed on as Coord packets             */
+void read_states(wire::BitReader &reader, PlayerEntry &entry, const Header &header,
+                 std::vector<Packet> &packets) {
+    StatesMsg msg;
+    StatesSchema::read(reader, msg);
+    const u16  newest   = msg.seq;
+    const uint copies   = msg.copies + 1;
+    const bool has_base = msg.has_base;
+    const uint offset   = has_base ? msg.base_offset : 0;
+
+    const uint near = entry.state_seq ? entry.state_seq : newest;
+    const uint seq  = extend_seq(near, newest);
+    const auto &base = state_slot(entry.states, seq - offset);
+    // without the base the states still have to be read to get past them
+    const bool can_decode = !has_base || base.seq == seq - offset;
+
+    for (uint s = seq - copies + 1; s <= seq; ++s) {
+        PlayerState state;
+        if (has_base) StateSchema::read_delta(reader, state, base.state);
+        else StateSchema::read(reader, state);
+        if (!reader.ok() || !can_decode || s == 0) continue;
+
+        const bool is_newest = s > entry.state_seq;
+        if (!receive_state(entry, s)) continue;
+        state_slot(entry.states, s) = {.seq = s, .state = state};
+        if (!is_newest) continue;
+
+        Packet pkt = {
+            .opcode     = Opcode::Coord,
+            .player_num = header.player_num,
+            .session    = header.session,
+            .seq        = s,
+        };
+        pkt.payload.move = {
+            .coord = {state.x, state.y},
+            .d_vel = {state.vel_x, state.vel_y},
+        };
+        packets.push_back(pkt);
+    }
+}
 
-    while (true) {
-        int rc = recvfrom(fd, &pkt, SIZE_PKT, 0, (sockaddr*)&s_addr, &sockl);
-        if (rc == 0) {
-            break;
-        } else if (rc != SIZE_PKT) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                // No more data available for now
+// turns the messages of one datagram into packets for the game
+void read_datagram(const byte *data, size_t size, const sockaddr_in &s_addr,
+                   double now, std::vector<Packet> &packets) {
+    wire::BitReader reader(data, size);
+    Header header;
+    HeaderSchema::read(reader, header);
+    if (!reader.ok() || header.version != WIRE_VERSION
+        || header.session != session_id || header.player_num == 0) return;
+
+    if (!player_entries.contains(header.player_num)) {
+        LOG_DBG("Local addr: {}", local_addr);
+        LOG_DBG("Added player's: {} address: {} to the list of known players", 
+                header.player_num, s_addr.sin_addr.s_addr);
+
+        // add the player_num to list
+        player_entries.emplace(header.player_num, PlayerEntry{
+            .player_num = header.player_num,
+            .saddr_in   = s_addr,
+        });
+    }
+    auto &entry = player_entries.at(header.player_num);
+
+    const size_t before = packets.size();
+    Packet pkt = {
+        .player_num = header.player_num,
+        .session    = header.session,
+        .seq        = header.seq,
+    };
+    bool done = false;
+    while (!done) {
+        const auto kind = MsgKind(reader.read(KIND_BITS));
+        if (!reader.ok()) break;
+        switch (kind) {
+            case MsgKind::Hello:
+                pkt.opcode = Opcode::Hello;
+                packets.push_back(pkt);
                 break;
-            } else {
-                perror("Failed to receive");
+            case MsgKind::MapInfo: {
+                MapInfoMsg info;
+                MapInfoSchema::read(reader, info);
+                if (!reader.ok()) break;
+                pkt.opcode = Opcode::Ack;
+                pkt.payload.map_buff_size = {.packed = info.packed, .raw = info.raw};
+                for (int i = 0; i < 8; ++i) {
+                    pkt.payload.map_hash[i]     = byte(info.hash_hi >> (56 - 8 * i));
+                    pkt.payload.map_hash[i + 8] = byte(info.hash_lo >> (56 - 8 * i));
+                }
+                packets.push_back(pkt);
+                break;
+            }
+            case MsgKind::MapDone:
+                pkt.opcode = Opcode::Done_Map;
+                packets.push_back(pkt);
+                break;
+            case MsgKind::State:
+                read_states(reader, entry, header, packets);
+                break;
+            case MsgKind::StateAck: {
+                StateAckMsg ack;
+                StateAckSchema::read(reader, ack);
+                if (!reader.ok() || ack.peer != config.pr_numb || sent_seq == 0) break;
+                const uint seq = sent_seq - u16(u16(sent_seq) - ack.seq);
+                if (seq >= entry.acked_seq) {
+                    entry.acked_seq     = seq;
+                    entry.acked_mask    = ack.mask;
+                }
                 break;
             }
-        } 
-        if (s_addr.sin_addr.s_addr == local_addr) break;
-
-        // else receive the packet if its not from this address
-        pkt = ntohpkt(pkt);
-        if (!player_entries.contains(pkt.player_num)) {
-            LOG_DBG("Local addr: {}", local_addr);
-            LOG_DBG("Added player's: {} address: {} to the list of known players", 
-                    pkt.player_num, s_addr.sin_addr.s_addr);
-
-            // add the player_num to list
-            player_entries.emplace(pkt.player_num, PlayerEntry{.saddr_in = s_addr});
+            case MsgKind::Segment: {
+                SegmentMsg seg;
+                SegmentSchema::read(reader, seg);
+                if (!reader.ok() || seg.size > SEGMENT_SIZE) {
+                    done = true;
+                    break;
+                }
+                byte data[SEGMENT_SIZE];
+                for (uint i = 0; i < seg.size; ++i) data[i] = reader.read(8);
+                if (!reader.ok()) break;
+                // the repairs for others are heard by everyone
+                if (header.player_num != map_owner || !map_receiver.active()) break;
+                // still repairing, the owner might have lost our last NACK
+                if (map_received && now >= next_nack) nack_due = true;
+                map_arrived.clear();
+                if (seg.parity) map_receiver.on_parity(seg.index, data, seg.size, map_arrived);
+                else map_receiver.on_segment(seg.index, data, seg.size, map_arrived);
+                // the game decodes what it can of the map right away
+                for (uint index: map_arrived) {
+                    pkt.opcode = Opcode::Map_Part;
+                    pkt.payload.map_part = {
+                        .offset = uint(index * SEGMENT_SIZE),
+                        .size   = uint(map_receiver.segment_size(index)),
+                    };
+                    packets.push_back(pkt);
+                }
+                break;
+            }
+            case MsgKind::Strokes: {
+                StrokesMsg msg;
+                StrokesSchema::read(reader, msg);
+                const uint first = extend_seq(entry.stroke_seq + 1, msg.first);
+                const uint count = msg.count + 1;
+                entry.heard_strokes = true;
+                stroke_acks_due = true;
+                for (uint seq = first; seq < first + count; ++seq) {
+                    StrokeMsg stroke;
+                    StrokeSchema::read(reader, stroke);
+                    if (!reader.ok()) break;
+                    // in order, the sender goes back to the first one we miss
+                    if (seq != entry.stroke_seq + 1) continue;
+                    ++entry.stroke_seq;
+                    pkt.opcode = Opcode::Stroke;
+                    pkt.payload.stroke = {
+                        .lamport    = stroke.lamport,
+                        .x          = stroke.x,
+                        .y          = stroke.y,
+                        .cell       = stroke.cell,
+                        .size       = stroke.size,
+                    };
+                    packets.push_back(pkt);
+                }
+                break;
+            }
+            case MsgKind::StrokeAck: {
+                StrokeAckMsg ack;
+                StrokeAckSchema::read(reader, ack);
+                if (!reader.ok() || ack.peer != config.pr_numb) break;
+                const uint seq = strokes_sent_end - u16(u16(strokes_sent_end) - ack.seq);
+                if (seq > entry.stroke_acked && seq <= strokes_sent_end) entry.stroke_acked = seq;
+                break;
+            }
+            case MsgKind::Inputs: {
+                InputsMsg msg;
+                InputsSchema::read(reader, msg);
+                const uint newest = msg.tick;
+                const uint run_count = msg.runs + 1;
+                std::array<InputRunMsg, INPUT_HISTORY> runs;
+                uint ticks = 0;
+                for (uint i = 0; i < run_count; ++i) {
+                    InputRunSchema::read(reader, runs[i]);
+                    ticks += runs[i].length + 1;
+                }
+                if (!reader.ok() || ticks > newest) break;
+                // oldest first, only the ticks not passed on before
+                uint tick = newest - ticks + 1;
+                pkt.opcode = Opcode::Input;
+                for (uint i = run_count; i-- > 0;) {
+                    for (uint n = 0; n <= runs[i].length; ++n, ++tick) {
+                        if (tick <= entry.input_tick) continue;
+                        pkt.payload.input = {
+                            .tick       = tick,
+                            .direction  = byte(runs[i].input & 3),
+                            .jump       = bool(runs[i].input >> 2 & 1),
+                        };
+                        packets.push_back(pkt);
+                    }
+                }
+                entry.input_tick = std::max(entry.input_tick, newest);
+                break;
+            }
+            case MsgKind::Sync: {
+                SyncMsg sync;
+                SyncSchema::read(reader, sync);
+                if (!reader.ok()) break;
+                pkt.opcode = Opcode::Sync;
+                pkt.payload.sync = {
+                    .tick       = sync.tick,
+                    .x          = sync.x,
+                    .y          = sync.y,
+                    .vel_x      = sync.vel_x,
+                    .vel_y      = sync.vel_y,
+                    .has_jumped = sync.has_jumped,
+                };
+                packets.push_back(pkt);
+                break;
+            }
+            case MsgKind::SegmentNack: {
+                SegmentNackMsg nack;
+                SegmentNackSchema::read(reader, nack);
+                if (!reader.ok() || !is_serving || map_source == nullptr) break;
+                // the first NACK of anyone starts the broadcast
+                if (!map_sender.active()) {
+                    LOG_DBG("Broadcasting the map, asked by player {}", header.player_num);
+                    map_sender.start(map_source, map_source_size);
+                }
+                if (nack.first < map_sender.segment_count()) {
+                    map_sender.on_nack(nack.first, nack.mask, now);
+                } else if (!entry.map_done) {
+                    entry.map_done = true;
+                    pkt.opcode = Opcode::Done_Map;
+                    packets.push_back(pkt);
+                }
+                break;
+            }
+            // End or a kind this version doesn't know
+            default:
+                done = true;
+                break;
+        }
+    }
+    packets_received.fetch_add(packets.size() - before, std::memory_order_relaxed);
+}
+
+void recv_udp_packets(int fd, std::vector<Packet> &packets) {
+    while (true) {
+        for (uint i = 0; i < RECV_BATCH; ++i) {
+            recv_msgs[i].msg_hdr.msg_namelen = sizeof(recv_addrs[i]);
+        }
+        int count = recvmmsg(fd, recv_msgs, RECV_BATCH, MSG_DONTWAIT, nullptr);
+        recv_calls.fetch_add(1, std::memory_order_relaxed);
+        if (count <= 0) {
+            if (count < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+                perror("Failed to receive");
+            }
+            // No more data available for now
+            break;
         }
+        const double now = now_sec();
 
-        // send the packet to the game if the most recent one received
-        auto &last_seq = player_entries.at(pkt.player_num).last_seq;
-        if (pkt.seq >= last_seq) {
-            packets.push_back(pkt);
-            last_seq = pkt.seq;
+        for (int i = 0; i < count; ++i) {
+            if (recv_msgs[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+            // already dropped by the socket filter, unless it failed to attach
+            if (recv_addrs[i].sin_addr.s_addr == local_addr) continue;
+            read_datagram(recv_slots[i], recv_msgs[i].msg_len, recv_addrs[i], now, packets);
         }
+        // a partial batch means the socket is drained
+        if (uint(count) < RECV_BATCH) break;
     }
 }
 
-bool listen_to_players() {
-    if (is_tcp_listening) {
-        LOG_ERR("TCP IS ALREADY LISTENING");
-        return false;
-    } 
-
-    // starts listening
-    if (listen(tcp_sfd, (int)sizeof(Packet::player_num) - 2) == -1) {
-        LOG_ERR("Failed to start listening on a TCP sock");
-        perror("What");
+bool start_map_download(byte player_num, uint byte_count) {
+    if (!player_entries.contains(player_num)) {
+        LOG_ERR("FATAL: CANNOT DOWNLOAD FROM NONEXISTING PLAYER!!!");
         return false;
-        // CREATE A MALFORMED PACKET TO INFORM THE PROGRAM ABOUT THE FAILURE!!!!!!
     }
-
-    // ADDING TCP SOCKET TO EPOLL
-    ev.events = EPOLLIN | EPOLLET;
-    ev.data.fd = tcp_sfd;
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, tcp_sfd, &ev) == -1) {
-        LOG_ERR("Epoll_ctl failed when adding TCP sock");
-        perror("What"); 
+    if (map_receiver.active()) {
+        LOG_DBG("The map is already being downloaded");
         return false;
     }
-    LOG_DBG("Listening for connections on TCP sock");
-    is_tcp_listening = true;
+    map_owner = player_num;
+    map_receiver.start(byte_count);
+    // ask for it right away
+    next_nack = 0;
+    LOG_DBG("Downloading {} bytes of the map from player {}", byte_count, player_num);
     return true;
 }
 
-void accept_tcp_conns(int fd) {
-    sockaddr_in cs_addr;
-    socklen_t c_slen = sizeof(cs_addr);
-    int c_sock = accept(fd, (sockaddr *)&cs_addr, &c_slen);
-    if (c_sock == -1) {
-        LOG_ERR("Failed to accept TCP client connection");
-        perror("What");
-        return;
-    }
+const std::vector<byte>& map_buffer() {
+    return map_receiver.data();
+}
 
-    // Add client socket to epoll
-    epoll_event event;
-    event.events = EPOLLOUT | EPOLLET;
-    event.data.fd = c_sock;
-    // double-check later on
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, c_sock, &event) == -1) {
-        LOG_ERR("Failed to add client TCP socket to epoll.");
-        perror("What");
+// timeout in msec, -1 sleeps until an event
+void wait_sockets(std::vector<Packet> &packets, int timeout) {
+    int num_events = epoll_wait(epollfd, events, MAX_EVENTS, timeout);
+    if (num_events == -1) {
+        if (errno == EINTR) {
+            LOG_DBG("Epoll skipping, program interrupted");
+        } else {
+            LOG_ERR("PANIC: Epoll wait failed");
+            perror("What"); 
+            exit(EXIT_FAILURE);
+        }
         return;
     }
-    LOG_DBG("New TCP client connected. fd: [{}]", c_sock);
-
-    // set values in the player_entries
-    // find by caddr, because the address is the only thing we know so far
-    for (auto& [player_num, info]: player_entries) {
-        if (info.saddr_in.sin_addr.s_addr == cs_addr.sin_addr.s_addr) {
-            info.tcp_sock       = c_sock;
-            info.tcp_bytes_sent = 0;
+    for (int i = 0; i < num_events; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == wake_fd) {
+            u64 count;
+            if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                perror("Failed to read the wake up event");
+            }
+        }
+        else if (fd == recv_udp_sfd) {
+            recv_udp_packets(fd, packets);
         }
-        break;
     }
 }
 
-bool write_tcp_buffer(PlayerEntry &info, std::vector<Packet>& packets) {
-    LOG_DBG("Trying to send on TCP stream... fd: {}", info.tcp_sock);
-    // how many bytes were written so far?
-    auto &write_point = info.tcp_bytes_sent;
-    int write_remain = tcp_buffer_size - write_point;
-    void *buff = tcp_buffer.data() + write_point;
-    LOG_DBG("remaining bytes to send {}", write_remain);
-
-    while (write_remain > 0) {
-        int rc = send(info.tcp_sock, buff, write_remain, 0);
-        if (rc > 0) {
-            write_point += rc;
-            write_remain -= rc;
-            LOG_DBG("Sent {} bytes, remaining {} on TCP stream", rc, write_remain);
-
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                LOG_DBG("Waiting for sending on TCP stream...");
+void run_commands() {
+    Command cmd;
+    while (outbound.pop(cmd)) {
+        switch (cmd.kind) {
+            case Command::Broadcast:
+                send_broadcast(cmd.pkt);
                 break;
-            }
-        } else if (rc == 0) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                LOG_DBG("Waiting for sending on TCP stream...");
+            case Command::RequestMap:
+                start_map_download(cmd.player_num, cmd.byte_count);
+                break;
+            case Command::ServeMap:
+                is_serving = true;
                 break;
-            } else {
-                LOG_ERR("Error in Sending TCP");
-                perror("What");
-            }
-            return false;
-            // send failure msg to main prog and handle th 
-        } else if (rc == -1) {
-            LOG_ERR("Error in the TCP Connection...");
-            perror("What");
-            return false;
         }
     }
-    if (write_remain == 0) {
-        packets.push_back(Packet {
-            .opcode = Opcode::Done_TCP,
-            .player_num = info.player_num,
-            .seq = 0,
-        });
-        return true;
-    }
-    return false;
-}
-
-// uses a newly generated fd by epoll
-void read_tcp_buffer(int fd, std::vector<Packet>& packets) {
-    // tcp_buffer_pointer
-    int curr_read;
-    size_t remaining = tcp_buffer_size - tcp_buffer_pointer;
-    void *buff_point = tcp_buffer.data() + tcp_buffer_pointer;
-    LOG_DBG("remaining {} on TCP stream", remaining);
-    while (tcp_buffer_pointer < tcp_buffer_size) {
-        curr_read = recv(fd, buff_point, remaining, 0);
-        if (curr_read > 0) {
-            tcp_buffer_pointer += curr_read;
-            remaining -= curr_read;
-            LOG_DBG("Received {} bytes, remaining {} on TCP stream", curr_read, remaining);
-
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                LOG_DBG("Waiting for more on TCP stream...");
-                break;
-            }
+}
+
+/* network thread main loop, sleeps in epoll untill a socket or *
+ * the game wakes it, or the map transfers need to run again    */
+void net_loop() {
+    std::vector<Packet> packets;
+    double wake = 0;
+    while (is_running.load(std::memory_order_acquire)) {
+        packets.clear();
+        int timeout = -1;
+        if (wake > 0) timeout = std::max(0, int((wake - now_sec()) * 1'000 + 1));
+        wait_sockets(packets, timeout);
+        run_commands();
+        const double now = now_sec();
+        wake = run_transfers(now, packets);
+        if (const double strokes = run_strokes(now); strokes > 0 && (wake == 0 || strokes < wake)) {
+            wake = strokes;
         }
-        else if (curr_read == 0) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                LOG_DBG("READ 0 ON TCP STREAM");
-                break;
-            } else {
-                LOG_ERR("Error in Reading TCP");
-                perror("What");
+        // everything queued this round goes out in one syscall, inputs
+        // are only written there
+        if (send_open || send_count > 0 || inputs_due) flush_broadcasts();
+        for (const auto &pkt: packets) {
+            if (!inbound.push(pkt)) {
+                LOG_ERR("Inbound packet queue is full, dropping a packet");
             }
-            return;
-            // send failure msg to main prog and handle th 
-        } else if (curr_read == -1) {
-            LOG_ERR("Error in the TCP Connection...");
-            perror("What");
-            return;
         }
     }
-    if (remaining == 0) {
-        // send to itself
-        packets.push_back(Packet {
-            .opcode = Opcode::Done_TCP,
-            .player_num = config.pr_numb,
-            .seq = 0,
-        });
+}
+
+void wake_net_thread() {
+    u64 one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("Failed to wake the network thread");
     }
 }
 
-std::vector<byte> return_tcp_buffer() {
-    return tcp_buffer;
+bool push_command(Command const &cmd) {
+    if (!outbound.push(cmd)) {
+        LOG_ERR("Outbound command queue is full");
+        return false;
+    }
+    wake_net_thread();
+    return true;
 }
 
-int player_num_to_tcp_sock(int tcp_sock) {
-    for (auto& [num, info]: player_entries) {
-        if (info.tcp_sock == tcp_sock) return num;
+// ------------- called from the game thread --------------
+
+void broadcast(Packet &pkt) {
+    if (!outbound.push({.kind = Command::Broadcast, .pkt = pkt})) {
+        LOG_ERR("Outbound command queue is full");
     }
-    return 0;
+}
+
+void flush() {
+    wake_net_thread();
+}
+
+bool request_map(byte player_num, uint byte_count) {
+    return push_command({
+        .kind       = Command::RequestMap,
+        .player_num = player_num,
+        .byte_count = byte_count,
+    });
+}
+
+bool serve_map() {
+    return push_command({.kind = Command::ServeMap});
+}
+
+Stats stats() {
+    return {
+        .packets_received   = packets_received.load(std::memory_order_relaxed),
+        .packets_sent       = packets_sent.load(std::memory_order_relaxed),
+        .recv_calls         = recv_calls.load(std::memory_order_relaxed),
+        .send_calls         = send_calls.load(std::memory_order_relaxed),
+    };
 }
 
 std::vector<Packet> poll() {
     std::vector<Packet> packets;
-    int num_events = epoll_wait(epollfd, events, MAX_EVENTS, 24);
-    if (num_events == -1) {
-        if (errno == EINTR) {
-            LOG_DBG("Epoll skipping, program interrupted");
-        } else {
-            LOG_ERR("PANIC: Epoll wait failed");
-            perror("What"); 
-            exit(EXIT_FAILURE);
-        }
-        return packets;
-    }
-    for (int i = 0; i < num_events; ++i) {
-        int fd = events[i].data.fd;
-        if (fd == recv_udp_sfd) {
-            recv_udp_packets(fd, packets);
-        } 
-        else if (fd == tcp_sfd && is_tcp_listening) {
-            accept_tcp_conns(fd);
-        } 
-        else if (fd == tcp_sfd && is_tcp_reading) {
-            read_tcp_buffer(fd, packets);
-        } 
-        else if (int p_num = player_num_to_tcp_sock(fd); p_num != 0) {
-            write_tcp_buffer(player_entries[p_num], packets);
-        }
+    Packet pkt;
+    while (inbound.pop(pkt)) {
+        packets.push_back(pkt);
     }
     return packets;
 }
@@ -10,8 +10,12 @@ namespace networking {
 enum Opcode: byte {
     Hello       = 0xF0,
     Ack         = 0x01,
-    Done_TCP    = 0x02,
+    Done_Map    = 0x02,
     Coord       = 0x04,
+    Map_Part    = 0x08,
+    Stroke      = 0x10,
+    Input       = 0x20,
+    Sync        = 0x40,
     Malformed   = 0xFF 
 };
 
@@ -21,20 +25,63 @@ union Data {
         float   d_vel[2];
     } move;
     struct {
-        uint    map_buff_size; // size of buffored data [for TCP]
+        // size of the map download, the map is sent RLE compressed
+        struct {
+            uint    packed;
+            uint    raw;
+        } map_buff_size;
+        // truncated hash of the map, lets peers load it from their cache
+        byte    map_hash[16];
     };
+    // bytes of the map download that arrived, readable in map_buffer()
+    struct {
+        uint    offset;
+        uint    size;
+    } map_part;
+    // a brush stroke of the drawing, see Stroke in Map.hpp
+    struct {
+        uint    lamport;
+        u16     x;
+        u16     y;
+        byte    cell;
+        byte    size;
+    } stroke;
+    // the player's input of one simulation step, see Input in Player.hpp
+    struct {
+        uint    tick;
+        byte    direction;
+        bool    jump;
+    } input;
+    // the exact state after the player's tick, see Player::State, velocities are raw Real
+    struct {
+        uint    tick;
+        i32     x;
+        i32     y;
+        i32     vel_x;
+        i32     vel_y;
+        bool    has_jumped;
+    } sync;
 };
 
+// what the game sends and receives, networking packs several of them
+// into one datagram of the wire format (see networking.cpp)
 struct Packet {
     Opcode  opcode;
     byte    player_num;
 
-    byte    __padding__[2] = {0,0};
+    u16     session = 0;    // set by networking, derived from the ESSID
 
     uint    seq; 
     Data    payload;
 };
 
+struct Stats {
+    u64     packets_received;   // passed on to the game
+    u64     packets_sent;
+    u64     recv_calls;         // recvmmsg syscalls
+    u64     send_calls;         // sendmmsg syscalls
+};
+
 struct NetConfig {
     c_str   device;
     c_str   essid;
@@ -47,16 +94,33 @@ struct NetConfig {
     uint    port;
 };
 
+// creates the sockets and starts the network thread which owns them
 bool setup(NetConfig &config);
 void destroy();
+// queues the packet, it is sent by the network thread after flush
+// Strokes are resent until every player has them, and each player's
+// arrive in the order they were broadcast, Inputs are repeated in the
+// following datagrams and each tick of a player arrives once, in order
 void broadcast(Packet &pkt);
-bool set_tcp_buffer(byte* byte_ptr, size_t size);
-// connects to player and sets a buffer to requested size
-bool connect_to_player(byte player_num, uint byte_count);
-bool listen_to_players();
+// sends everything broadcast since the last flush in one batch
+void flush();
+// bytes sent to players downloading the map, not copied so they have
+// to outlive the transfers, has to be called before serve_map
+bool set_map_source(const byte* byte_ptr, size_t size);
+// downloads byte_count bytes of the map the player broadcasts, NACKing
+// what is lost, Map_Part as pieces arrive in any order and Done_Map
+// with our player number when complete
+bool request_map(byte player_num, uint byte_count);
+// broadcasts the map once any player requests it and repairs what they
+// NACK, Done_Map with their player number as each of them has all of it
+bool serve_map();
+// returns packets received since the last call, never blocks
 std::vector<Packet> poll();
+// counters since setup, safe to read from the game thread
+Stats stats();
 
-// request the tcp buffer
-std::vector<byte> return_tcp_buffer();
+// the downloaded map, the bytes of a Map_Part are never written again
+// once it was received, all of them once Done_Map was
+const std::vector<byte>& map_buffer();
 };
 #endif //ADHTP_NETWORK_HDR
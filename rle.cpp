@@ -0,0 +1,62 @@
+#include "rle.hpp"
+
+#include <cstring>
+
+namespace rle {
+
+std::vector<byte> encode(const byte *src, size_t size) {
+    std::vector<byte> out;
+    out.reserve(1024);
+
+    size_t i = 0;
+    while (i < size) {
+        const byte value = src[i];
+        size_t run = 1;
+        while (i + run < size && src[i + run] == value) ++run;
+        i += run;
+
+        out.push_back(value);
+        // varint, 7 bits per byte, high bit marks continuation
+        size_t len = run - 1;
+        while (len >= 0x80) {
+            out.push_back(byte(len | 0x80));
+            len >>= 7;
+        }
+        out.push_back(byte(len));
+    }
+    return out;
+}
+
+bool decode(const byte *src, size_t size, byte *dst, size_t dst_size) {
+    size_t in  = 0;
+    size_t out = 0;
+    while (in < size) {
+        const byte value = src[in++];
+        size_t len  = 0;
+        uint shift  = 0;
+        while (true) {
+            if (in >= size || shift > 28) {
+                LOG_ERR("RLE: truncated run length");
+                return false;
+            }
+            const byte b = src[in++];
+            len |= size_t(b & 0x7f) << shift;
+            shift += 7;
+            if ((b & 0x80) == 0) break;
+        }
+        const size_t run = len + 1;
+        if (run > dst_size - out) {
+            LOG_ERR("RLE: run overflows the output buffer");
+            return false;
+        }
+        memset(dst + out, value, run);
+        out += run;
+    }
+    if (out != dst_size) {
+        LOG_ERR("RLE: decoded {} bytes, expected {}", out, dst_size);
+        return false;
+    }
+    return true;
+}
+
+};
@@ -0,0 +1,19 @@
+#ifndef ADHTP_RLE_HDR
+#define ADHTP_RLE_HDR
+
+#include "types.hpp"
+#include <cstddef>
+#include <vector>
+
+/* run-length coding of map cells:                          *
+ * every run is stored as [cell value][run length - 1]      *
+ * with the length as a LEB128 varint, so a row of EMPTY    *
+ * cells costs 3 bytes and an empty map costs 4 bytes       */
+namespace rle {
+
+std::vector<byte> encode(const byte *src, size_t size);
+// decodes straight into dst, fails unless exactly dst_size bytes are produced
+bool decode(const byte *src, size_t size, byte *dst, size_t dst_size);
+
+};
+#endif //ADHTP_RLE_HDR
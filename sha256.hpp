@@ -0,0 +1,17 @@
+#ifndef ADHTP_SHA256_HDR
+#define ADHTP_SHA256_HDR
+
+#include "types.hpp"
+#include <array>
+#include <cstddef>
+#include <string>
+
+namespace sha256 {
+
+using Digest = std::array<byte, 32>;
+
+Digest hash(const byte *data, size_t size);
+std::string to_hex(const byte *data, size_t size);
+
+};
+#endif //ADHTP_SHA256_HDR
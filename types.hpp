@@ -7,8 +7,10 @@
 #include <inttypes.h>
 
 using i32   = int_fast32_t;
+using u16   = uint16_t;
 using uint  = uint32_t;
 using u64   = uint64_t;
+using i64   = int64_t;
 using byte  = unsigned char;
 using c_str = const char*;
 
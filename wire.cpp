@@ -0,0 +1,46 @@
+#include "wire.hpp"
+
+namespace wire {
+
+BitWriter::BitWriter(byte *buffer, size_t size)
+    : _buffer(buffer), _capacity(size * 8) {}
+
+void BitWriter::write(u64 value, uint bits) {
+    if (_overflow || bits > bits_left()) {
+        _overflow = true;
+        return;
+    }
+    while (bits > 0) {
+        const uint bit  = _pos % 8;
+        const uint take = std::min(bits, 8 - bit);
+        const byte part = byte((value >> (bits - take)) & max_code(take));
+        byte &dst = _buffer[_pos / 8];
+        // a fresh byte starts cleared, the buffer is reused between datagrams
+        if (bit == 0) dst = 0;
+        dst |= byte(part << (8 - bit - take));
+        _pos += take;
+        bits -= take;
+    }
+}
+
+BitReader::BitReader(const byte *buffer, size_t size)
+    : _buffer(buffer), _capacity(size * 8) {}
+
+u64 BitReader::read(uint bits) {
+    if (_overflow || bits > bits_left()) {
+        _overflow = true;
+        return 0;
+    }
+    u64 value = 0;
+    while (bits > 0) {
+        const uint bit  = _pos % 8;
+        const uint take = std::min(bits, 8 - bit);
+        const byte src  = _buffer[_pos / 8];
+        value = (value << take) | ((src >> (8 - bit - take)) & max_code(take));
+        _pos += take;
+        bits -= take;
+    }
+    return value;
+}
+
+} // namespace wire
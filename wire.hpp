@@ -0,0 +1,187 @@
+#ifndef ADHTP_WIRE_HDR
+#define ADHTP_WIRE_HDR
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#include "types.hpp"
+
+/* bit level serialization, messages are described once by a   *
+ * Schema of fields and the readers / writers (full and delta) *
+ * are generated from it at compile time                       */
+namespace wire {
+
+// MSB first, so multi byte fields end up in network order
+struct BitWriter {
+    BitWriter(byte *buffer, size_t size);
+
+    // the low `bits` bits of value
+    void write(u64 value, uint bits);
+    // false once a write didn't fit
+    bool ok() const { return !_overflow; }
+    size_t bits_left() const { return _capacity - _pos; }
+    // bytes used so far, the last one padded with zeros
+    size_t size() const { return (_pos + 7) / 8; }
+
+private:
+    byte    *_buffer;
+    size_t  _capacity;  // in bits
+    size_t  _pos        = 0;
+    bool    _overflow   = false;
+};
+
+struct BitReader {
+    BitReader(const byte *buffer, size_t size);
+
+    // reads past the end return 0 and fail the reader
+    u64 read(uint bits);
+    bool ok() const { return !_overflow; }
+    size_t bits_left() const { return _capacity - _pos; }
+
+private:
+    const byte  *_buffer;
+    size_t      _capacity;
+    size_t      _pos        = 0;
+    bool        _overflow   = false;
+};
+
+constexpr u64 zigzag(i64 value) {
+    return (u64(value) << 1) ^ u64(value >> 63);
+}
+
+constexpr i64 unzigzag(u64 value) {
+    return i64(value >> 1) ^ -i64(value & 1);
+}
+
+constexpr u64 max_code(uint bits) {
+    return bits >= 64 ? ~u64(0) : (u64(1) << bits) - 1;
+}
+
+template <class M> struct member_traits;
+template <class C, class T> struct member_traits<T C::*> {
+    using owner = C;
+    using type  = T;
+};
+
+/* integral or enum member in Bits bits, signed values are    *
+ * stored offset by half the range so the codes stay ordered  *
+ * out of range values are clamped                            */
+template <auto Member, uint Bits, uint DeltaBits = (Bits + 1) / 2>
+struct Field {
+    using Owner = typename member_traits<decltype(Member)>::owner;
+    using Type  = typename member_traits<decltype(Member)>::type;
+    static_assert(std::is_integral_v<Type> || std::is_enum_v<Type>);
+    static_assert(Bits > 0 && Bits <= 64 && DeltaBits < Bits);
+
+    static constexpr uint BITS          = Bits;
+    static constexpr uint DELTA_BITS    = DeltaBits;
+
+    static u64 encode(const Owner &owner) {
+        const auto value = owner.*Member;
+        if constexpr (std::is_signed_v<Type>) {
+            constexpr i64 half = i64(max_code(Bits - 1));
+            const i64 v = std::clamp<i64>(value, -half - 1, half);
+            return u64(v + half + 1);
+        } else {
+            return std::min<u64>(u64(value), max_code(Bits));
+        }
+    }
+
+    static void decode(u64 code, Owner &owner) {
+        if constexpr (std::is_signed_v<Type>) {
+            constexpr i64 half = i64(max_code(Bits - 1));
+            owner.*Member = Type(i64(code) - half - 1);
+        } else {
+            owner.*Member = Type(code);
+        }
+    }
+};
+
+// float member quantized to Bits over [Min, Max), the midpoint is exact
+template <auto Member, float Min, float Max, uint Bits, uint DeltaBits = (Bits + 1) / 2>
+struct Quantized {
+    using Owner = typename member_traits<decltype(Member)>::owner;
+    static_assert(Min < Max && Bits > 0 && Bits < 32 && DeltaBits < Bits);
+
+    static constexpr uint   BITS        = Bits;
+    static constexpr uint   DELTA_BITS  = DeltaBits;
+    static constexpr float  STEP        = (Max - Min) / float(u64(1) << Bits);
+
+    static u64 encode(const Owner &owner) {
+        const float v = std::clamp(float(owner.*Member), Min, Max);
+        return std::min<u64>(std::lround((v - Min) / STEP), max_code(Bits));
+    }
+
+    static void decode(u64 code, Owner &owner) {
+        owner.*Member = Min + float(code) * STEP;
+    }
+};
+
+/* a message layout, the fields are written in order             *
+ * a delta against a base writes one bit for unchanged fields,  *
+ * small changes as a short signed offset and the rest in full  */
+template <class... Fields>
+struct Schema {
+    static constexpr uint BITS = (Fields::BITS + ...);
+    // upper bound of a delta encoded message
+    static constexpr uint MAX_DELTA_BITS = ((Fields::BITS + 2) + ...);
+
+    template <class T>
+    static void write(BitWriter &writer, const T &value) {
+        (writer.write(Fields::encode(value), Fields::BITS), ...);
+    }
+
+    template <class T>
+    static void read(BitReader &reader, T &value) {
+        (Fields::decode(reader.read(Fields::BITS), value), ...);
+    }
+
+    template <class T>
+    static void write_delta(BitWriter &writer, const T &value, const T &base) {
+        (_write_delta<Fields>(writer, value, base), ...);
+    }
+
+    // value starts out as a copy of base
+    template <class T>
+    static void read_delta(BitReader &reader, T &value, const T &base) {
+        value = base;
+        (_read_delta<Fields>(reader, value, base), ...);
+    }
+
+private:
+    template <class F, class T>
+    static void _write_delta(BitWriter &writer, const T &value, const T &base) {
+        const u64 code = F::encode(value);
+        const u64 base_code = F::encode(base);
+        if (code == base_code) {
+            writer.write(0, 1);
+            return;
+        }
+        writer.write(1, 1);
+        const u64 offset = zigzag(i64(code) - i64(base_code));
+        if (offset <= max_code(F::DELTA_BITS)) {
+            writer.write(1, 1);
+            writer.write(offset, F::DELTA_BITS);
+        } else {
+            writer.write(0, 1);
+            writer.write(code, F::BITS);
+        }
+    }
+
+    template <class F, class T>
+    static void _read_delta(BitReader &reader, T &value, const T &base) {
+        if (!reader.read(1)) return;
+        if (reader.read(1)) {
+            const i64 offset = unzigzag(reader.read(F::DELTA_BITS));
+            F::decode(u64(i64(F::encode(base)) + offset), value);
+        } else {
+            F::decode(reader.read(F::BITS), value);
+        }
+    }
+};
+
+} // namespace wire
+
+#endif //ADHTP_WIRE_HDR